@@ -1,9 +1,16 @@
 #include "buffer.h"
 
-Buffer::Buffer(int initBuffSize):buffer_(initBuffSize),readPos_(0),writePos_(0){};
+char Buffer::EMPTY_[1];
+
+Buffer::Buffer(int initBuffSize):buffer_(EMPTY_), capacity_(0),
+    initSize_(initBuffSize > 0 ? initBuffSize : BufferPool::MIN_SIZE), readPos_(0), writePos_(0){}
+
+Buffer::~Buffer(){
+    if(capacity_ > 0)BufferPool::Instance()->Return(buffer_, capacity_);
+}
 
 size_t Buffer::WritableBytes()const{
-    return buffer_.size() - writePos_;
+    return capacity_ - writePos_;
 }
 
 size_t Buffer::ReadableBytes()const{
@@ -15,19 +22,26 @@ size_t Buffer::PrependableBytes()const{
 }
 
 const char* Buffer::Peek()const{
-    return &buffer_[readPos_];
+    return buffer_ + readPos_;
 }
 
 void Buffer::MakeSpace_(size_t len){
-    if(PrependableBytes() + WritableBytes() < len){//重新分配
-        buffer_.resize(writePos_ + len + 1);
+    size_t readable = ReadableBytes();
+    if(PrependableBytes() + WritableBytes() < len){//换一块更大的，只拷贝可读部分
+        size_t want = readable + len;
+        if(want < initSize_)want = initSize_;
+        size_t cap = 0;
+        char* data = BufferPool::Instance()->Borrow(want, &cap);
+        memcpy(data, Peek(), readable);
+        if(capacity_ > 0)BufferPool::Instance()->Return(buffer_, capacity_);
+        buffer_ = data;
+        capacity_ = cap;
     }else{//前移
-        size_t readable = ReadableBytes();
-        std::copy(BeginPtr_() + readPos_, BeginPtr_() + writePos_ , BeginPtr_());
-        readPos_ = 0;
-        writePos_ = readable;
-        assert(readable == ReadableBytes());
+        memmove(BeginPtr_(), Peek(), readable);
     }
+    readPos_ = 0;
+    writePos_ = readable;
+    assert(readable == ReadableBytes());
 }
 
 void Buffer::EnsureWriteable(size_t len){
@@ -52,9 +66,16 @@ void Buffer::RetrieveUntil(const char* end){
     Retrieve(end - Peek());
 }
 
-//清空所有数据，全部归0
+//清空所有数据，只重置下标，不清零内存
 void Buffer::RetrieveAll(){
-    bzero(&buffer_[0], buffer_.size());
+    readPos_ = 0, writePos_ = 0;
+}
+
+void Buffer::Release(){
+    if(capacity_ == 0 || ReadableBytes() > 0)return;
+    BufferPool::Instance()->Return(buffer_, capacity_);
+    buffer_ = EMPTY_;
+    capacity_ = 0;
     readPos_ = 0, writePos_ = 0;
 }
 
@@ -65,17 +86,17 @@ std::string Buffer::RetrieveAllToStr(){
 }
 
 const char* Buffer::BeginWriteConst() const{
-    return &buffer_[writePos_];
+    return buffer_ + writePos_;
 }
 
 char* Buffer::BeginWrite(){
-    return &buffer_[writePos_];
+    return buffer_ + writePos_;
 }
 
 void Buffer::Append(const char* str, size_t len){
     assert(str);
     EnsureWriteable(len);
-    std::copy(str, str+ len, BeginWrite());
+    memcpy(BeginWrite(), str, len);
     HasWritten(len);
 }
 
@@ -94,15 +115,21 @@ void Buffer::Append(const Buffer& buff){
 }
 
 ssize_t Buffer::ReadFd(int fd, int* Errno){
-    char buff[65535];
     struct iovec iov[2];
+    if(capacity_ == 0){
+        //空闲时不占内存，有数据要读了才借，尽量直接读进借来的内存
+        EnsureWriteable(initSize_);
+    }
     size_t writeable = WritableBytes();
+    //放不下的部分先读进从BufferPool借的临时块，不再每次在栈上开64KB
+    size_t spareCap = 0;
+    char* spare = BufferPool::Instance()->Borrow(SPARE_SIZE, &spareCap);
 
 //分散读，优先将数据读到iov[0]，空间不够再用iov[1]
     iov[0].iov_base = BeginWrite();
     iov[0].iov_len = writeable;
-    iov[1].iov_base = buff;
-    iov[1].iov_len = sizeof(buff);
+    iov[1].iov_base = spare;
+    iov[1].iov_len = spareCap;
 
 //readv 可以读到多个缓冲区
     ssize_t len = readv(fd, iov, 2);
@@ -111,9 +138,10 @@ ssize_t Buffer::ReadFd(int fd, int* Errno){
     }else if(static_cast<size_t>(len) <= writeable){//当前buffer就够写下
         writePos_ += len;
     }else{//当前buffer写不下，用了iov[1]的buffer
-        writePos_ = buffer_.size();
-        Append(buff,static_cast<size_t>(len - writeable));
+        writePos_ = capacity_;
+        Append(spare, static_cast<size_t>(len - writeable));
     }
+    BufferPool::Instance()->Return(spare, spareCap);
     return len;
 }
 
@@ -128,9 +156,9 @@ ssize_t Buffer::WriteFd(int fd, int* Errno){
 }
 
 char* Buffer::BeginPtr_(){
-    return &buffer_[0];
+    return buffer_;
 }
 
 const char* Buffer::BeginPtr_() const{
-    return &buffer_[0];
+    return buffer_;
 }
@@ -7,10 +7,15 @@
 #include <vector> //readv
 #include <atomic>
 #include <assert.h>
+#include "bufferpool.h"
+
+//内存从BufferPool借：构造时不分配，第一次写入才借，Release后还回去
 class Buffer {
 public:
-    Buffer(int initBuffSize = 1024);
-    ~Buffer() = default;
+    Buffer(int initBuffSize = 1024);    //initBuffSize为第一次借内存时的最小大小
+    ~Buffer();
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
 
     size_t WritableBytes() const;       
     size_t ReadableBytes() const ;
@@ -25,6 +30,7 @@ public:
 
     void RetrieveAll();
     std::string RetrieveAllToStr();
+    void Release();     //没有可读数据时把内存还给BufferPool，空闲连接不占内存
 
     const char* BeginWriteConst() const;
     char* BeginWrite();
@@ -42,7 +48,12 @@ private:
     const char* BeginPtr_() const;
     void MakeSpace_(size_t len);
 
-    std::vector<char> buffer_;  
+    static const size_t SPARE_SIZE = 64 * 1024;  //ReadFd临时块的大小
+    static char EMPTY_[1];      //没有借内存时指向这里，Peek/BeginWrite总是返回有效指针
+
+    char* buffer_;
+    size_t capacity_;
+    size_t initSize_;
     std::atomic<std::size_t> readPos_;  // 读的下标
     std::atomic<std::size_t> writePos_; // 写的下标
 };
@@ -0,0 +1,91 @@
+#include "bufferpool.h"
+
+using namespace std;
+
+BufferPool* BufferPool::Instance(){
+    //不析构：线程退出时的线程缓存、全局对象里的Buffer析构时都还要归还内存
+    static BufferPool* pool = new BufferPool();
+    return pool;
+}
+
+int BufferPool::ClassOf_(size_t len){
+    if(len <= MIN_SIZE)return 0;
+    return 64 - __builtin_clzll(len - 1) - MIN_SHIFT;
+}
+
+size_t BufferPool::LocalLimit_(int cls){
+    size_t n = LOCAL_BYTES >> (MIN_SHIFT + cls);
+    return n < 1 ? 1 : n;
+}
+
+BufferPool::LocalCache& BufferPool::Local_(){
+    thread_local LocalCache cache;
+    return cache;
+}
+
+BufferPool::LocalCache::~LocalCache(){
+    for(int cls = 0; cls < CLASS_NUM; cls++){
+        BufferPool::Instance()->Flush_(cls, blocks[cls], 0);
+    }
+}
+
+char* BufferPool::Borrow(size_t len, size_t* cap){
+    if(len > MAX_SIZE){
+        *cap = len;
+        return static_cast<char*>(malloc(len));
+    }
+    int cls = ClassOf_(len);
+    *cap = MIN_SIZE << cls;
+    vector<char*>& local = Local_().blocks[cls];
+    if(local.empty())Refill_(cls, local);
+    if(local.empty()){
+        return static_cast<char*>(malloc(*cap));
+    }
+    char* data = local.back();
+    local.pop_back();
+    return data;
+}
+
+void BufferPool::Return(char* data, size_t cap){
+    if(!data)return;
+    if(cap > MAX_SIZE){
+        free(data);
+        return;
+    }
+    int cls = ClassOf_(cap);
+    vector<char*>& local = Local_().blocks[cls];
+    local.push_back(data);
+    if(local.size() > LocalLimit_(cls)){
+        //留一半给本线程，另一半交给全局，别的线程可以拿去用
+        Flush_(cls, local, LocalLimit_(cls) / 2);
+    }
+}
+
+//从全局链表批量拿一半线程缓存上限的块
+void BufferPool::Refill_(int cls, vector<char*>& local){
+    FreeList& list = lists_[cls];
+    size_t want = (LocalLimit_(cls) + 1) / 2;
+    lock_guard<mutex> locker(list.mtx);
+    while(want-- > 0 && !list.blocks.empty()){
+        local.push_back(list.blocks.back());
+        list.blocks.pop_back();
+        cachedBytes_ -= MIN_SIZE << cls;
+    }
+}
+
+//线程缓存只留keep块，其余交给全局链表，全局缓存超过上限的直接释放
+void BufferPool::Flush_(int cls, vector<char*>& local, size_t keep){
+    size_t size = MIN_SIZE << cls;
+    FreeList& list = lists_[cls];
+    lock_guard<mutex> locker(list.mtx);
+    while(local.size() > keep){
+        char* data = local.back();
+        local.pop_back();
+        if(cachedBytes_ + size > MAX_CACHED_BYTES){
+            free(data);
+        }else{
+            list.blocks.push_back(data);
+            cachedBytes_ += size;
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <mutex>
+#include <atomic>
+#include <vector>
+
+//按2的幂分级(1KB~1MB)的内存块池，Buffer有数据时才借、空闲时归还，块不清零。
+//每个线程先在自己的缓存里借还，缓存满了或空了才和全局链表成批交换，减少锁竞争
+class BufferPool{
+public:
+    static BufferPool* Instance();
+
+    //借一块至少len字节的内存，实际大小写入cap
+    char* Borrow(size_t len, size_t* cap);
+    void Return(char* data, size_t cap);
+
+    size_t CachedBytes() const { return cachedBytes_; }
+
+    static const size_t MIN_SIZE = 1024;
+    static const size_t MAX_SIZE = 1024 * 1024;     //更大的直接malloc/free，不进池
+
+private:
+    BufferPool():cachedBytes_(0){}
+    ~BufferPool() = default;
+
+    static const int MIN_SHIFT = 10;
+    static const int CLASS_NUM = 11;
+    static const size_t LOCAL_BYTES = 256 * 1024;           //每个线程每级缓存的字节数上限
+    static const size_t MAX_CACHED_BYTES = 64 * 1024 * 1024; //全局链表缓存的字节数上限，超过就还给系统
+
+    struct LocalCache{
+        std::vector<char*> blocks[CLASS_NUM];
+        ~LocalCache();
+    };
+
+    struct FreeList{
+        std::mutex mtx;
+        std::vector<char*> blocks;
+    };
+
+    static int ClassOf_(size_t len);
+    static size_t LocalLimit_(int cls);
+    static LocalCache& Local_();
+    void Refill_(int cls, std::vector<char*>& local);
+    void Flush_(int cls, std::vector<char*>& local, size_t keep);
+
+    std::atomic<size_t> cachedBytes_;
+    FreeList lists_[CLASS_NUM];
+};
+
+#endif
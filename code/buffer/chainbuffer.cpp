@@ -0,0 +1,166 @@
+#include "chainbuffer.h"
+
+ChainBuffer::~ChainBuffer(){
+    for(Chunk& chunk: chunks_){
+        Return_(chunk.data);
+    }
+}
+
+char* ChainBuffer::Borrow_(){
+    size_t cap = 0;
+    char* data = BufferPool::Instance()->Borrow(CHUNK_SIZE, &cap);
+    assert(cap == CHUNK_SIZE);
+    return data;
+}
+
+void ChainBuffer::Return_(char* data){
+    BufferPool::Instance()->Return(data, CHUNK_SIZE);
+}
+
+const char* ChainBuffer::Peek() const{
+    if(chunks_.empty())return "";
+    return chunks_.front().data + chunks_.front().read;
+}
+
+size_t ChainBuffer::PeekBytes() const{
+    if(chunks_.empty())return 0;
+    return chunks_.front().write - chunks_.front().read;
+}
+
+void ChainBuffer::MakeContiguous(size_t len){
+    assert(len <= CHUNK_SIZE && len <= readable_);
+    if(PeekBytes() >= len)return;
+    Chunk& front = chunks_.front();
+    if(CHUNK_SIZE - front.read < len){
+        //块尾放不下，先把已有的数据移到块首
+        memmove(front.data, front.data + front.read, front.write - front.read);
+        front.write -= front.read;
+        front.read = 0;
+    }
+    while(chunks_[0].write - chunks_[0].read < len){
+        Chunk& head = chunks_[0];
+        Chunk& next = chunks_[1];
+        size_t need = len - (head.write - head.read);
+        size_t n = need < next.write - next.read ? need : next.write - next.read;
+        memcpy(head.data + head.write, next.data + next.read, n);
+        head.write += n;
+        next.read += n;
+        if(next.read == next.write){
+            Return_(next.data);
+            chunks_.erase(chunks_.begin() + 1);
+        }
+    }
+}
+
+void ChainBuffer::Retrieve(size_t len){
+    assert(len <= readable_);
+    readable_ -= len;
+    while(len > 0){
+        Chunk& front = chunks_.front();
+        size_t n = len < front.write - front.read ? len : front.write - front.read;
+        front.read += n;
+        len -= n;
+        if(front.read == front.write){
+            if(chunks_.size() == 1){
+                //最后一个块留着给下一次读
+                front.read = front.write = 0;
+            }else{
+                Return_(front.data);
+                chunks_.pop_front();
+            }
+        }
+    }
+}
+
+void ChainBuffer::RetrieveAll(){
+    for(Chunk& chunk: chunks_){
+        Return_(chunk.data);
+    }
+    chunks_.clear();
+    readable_ = 0;
+}
+
+void ChainBuffer::Release(){
+    if(readable_ == 0)RetrieveAll();
+}
+
+void ChainBuffer::Append(const char* data, size_t len){
+    while(len > 0){
+        if(chunks_.empty() || chunks_.back().write == CHUNK_SIZE){
+            chunks_.push_back({Borrow_(), 0, 0});
+        }
+        Chunk& tail = chunks_.back();
+        size_t n = len < CHUNK_SIZE - tail.write ? len : CHUNK_SIZE - tail.write;
+        memcpy(tail.data + tail.write, data, n);
+        tail.write += n;
+        readable_ += n;
+        data += n;
+        len -= n;
+    }
+}
+
+int ChainBuffer::ReadIov(struct iovec* iov, int maxIov) const{
+    int cnt = 0;
+    for(const Chunk& chunk: chunks_){
+        if(cnt == maxIov)break;
+        if(chunk.write == chunk.read)continue;
+        iov[cnt].iov_base = chunk.data + chunk.read;
+        iov[cnt].iov_len = chunk.write - chunk.read;
+        cnt++;
+    }
+    return cnt;
+}
+
+//先填满最后一个块的剩余空间，再读进新借的块，没用上的块马上还回去
+ssize_t ChainBuffer::ReadFd(int fd, int* Errno){
+    struct iovec iov[READ_CHUNKS + 1];
+    char* fresh[READ_CHUNKS];
+    int cnt = 0;
+    size_t spare = 0;
+    if(!chunks_.empty() && chunks_.back().write < CHUNK_SIZE){
+        Chunk& tail = chunks_.back();
+        spare = CHUNK_SIZE - tail.write;
+        iov[cnt].iov_base = tail.data + tail.write;
+        iov[cnt].iov_len = spare;
+        cnt++;
+    }
+    for(int i = 0; i < READ_CHUNKS; i++){
+        fresh[i] = Borrow_();
+        iov[cnt].iov_base = fresh[i];
+        iov[cnt].iov_len = CHUNK_SIZE;
+        cnt++;
+    }
+    ssize_t len = readv(fd, iov, cnt);
+    if(len < 0){
+        *Errno = errno;
+    }
+    size_t left = len > 0 ? len : 0;
+    readable_ += left;
+    if(spare > 0){
+        size_t n = left < spare ? left : spare;
+        chunks_.back().write += n;
+        left -= n;
+    }
+    for(int i = 0; i < READ_CHUNKS; i++){
+        if(left > 0){
+            size_t n = left < CHUNK_SIZE ? left : CHUNK_SIZE;
+            chunks_.push_back({fresh[i], 0, n});
+            left -= n;
+        }else{
+            Return_(fresh[i]);
+        }
+    }
+    return len;
+}
+
+ssize_t ChainBuffer::WriteFd(int fd, int* Errno){
+    struct iovec iov[IOV_MAX_CHUNKS];
+    int cnt = ReadIov(iov, IOV_MAX_CHUNKS);
+    ssize_t len = writev(fd, iov, cnt);
+    if(len < 0){
+        *Errno = errno;
+        return len;
+    }
+    Retrieve(len);
+    return len;
+}
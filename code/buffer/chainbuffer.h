@@ -0,0 +1,57 @@
+#ifndef CHAIN_BUFFER_H
+#define CHAIN_BUFFER_H
+
+#include <deque>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <assert.h>
+#include "bufferpool.h"
+
+//由BufferPool里定长块串起来的缓冲区：readv直接读进块里，长度增长不需要realloc和整体搬移，
+//写出时把各块作为iovec交给writev。解析器按块取连续的片段，只有一行跨了块时才拼到第一个块里
+class ChainBuffer{
+public:
+    static const size_t CHUNK_SIZE = 16 * 1024;
+
+    ChainBuffer():readable_(0){}
+    ~ChainBuffer();
+    ChainBuffer(const ChainBuffer&) = delete;
+    ChainBuffer& operator=(const ChainBuffer&) = delete;
+
+    size_t ReadableBytes() const { return readable_; }
+
+    //第一个块里连续可读的部分，有数据时PeekBytes()一定大于0
+    const char* Peek() const;
+    size_t PeekBytes() const;
+    void MakeContiguous(size_t len);    //让前len(不超过CHUNK_SIZE)个字节落在第一个块里
+
+    void Retrieve(size_t len);
+    void RetrieveAll();
+    void Release();         //没有数据时把块全部还给BufferPool
+
+    void Append(const char* data, size_t len);
+    int ReadIov(struct iovec* iov, int maxIov) const;   //可读数据对应的iovec，返回个数
+
+    ssize_t ReadFd(int fd, int* Errno);
+    ssize_t WriteFd(int fd, int* Errno);
+
+private:
+    struct Chunk{
+        char* data;
+        size_t read;
+        size_t write;
+    };
+
+    static char* Borrow_();
+    static void Return_(char* data);
+
+    static const int READ_CHUNKS = 4;   //一次readv最多新用的块数
+    static const int IOV_MAX_CHUNKS = 64;
+
+    std::deque<Chunk> chunks_;
+    size_t readable_;
+};
+
+#endif
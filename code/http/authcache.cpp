@@ -0,0 +1,112 @@
+#include "authcache.h"
+#include <random>
+
+using namespace std;
+
+AuthCache* AuthCache::Instance(){
+    static AuthCache cache;
+    return &cache;
+}
+
+AuthCache::AuthCache():shardCapacity_(0), ttlMs_(0), negativeTtlMs_(0), salt_(0), isOpen_(false),
+    hits_(0), misses_(0){}
+
+AuthCache::~AuthCache(){
+    Close();
+}
+
+bool AuthCache::Init(size_t capacity, int ttlMs, int negativeTtlMs){
+    Close();
+    if(capacity == 0 || ttlMs <= 0)return false;
+    shardCapacity_ = (capacity + SHARD_NUM - 1) / SHARD_NUM;
+    ttlMs_ = ttlMs;
+    negativeTtlMs_ = negativeTtlMs;
+    random_device rd;
+    salt_ = ((uint64_t)rd() << 32) | rd();
+    hits_ = misses_ = 0;
+    isOpen_ = true;
+    return true;
+}
+
+void AuthCache::Close(){
+    if(isOpen_){
+        LOG_INFO("AuthCache hits: %llu, misses: %llu", (unsigned long long)hits_, (unsigned long long)misses_);
+    }
+    isOpen_ = false;
+    for(auto& shard: shards_){
+        lock_guard<mutex> locker(shard.mtx);
+        shard.index.clear();
+        shard.lru.clear();
+    }
+}
+
+AuthCache::Shard& AuthCache::ShardOf_(const string& name){
+    return shards_[hash<string>()(name) % SHARD_NUM];
+}
+
+//带盐的FNV-1a，只用来在进程内比对，内存里不留明文密码
+uint64_t AuthCache::Hash_(const string& pwd) const{
+    uint64_t hash = 14695981039346656037ULL ^ salt_;
+    for(unsigned char ch: pwd){
+        hash = (hash ^ ch) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+AuthCache::RESULT AuthCache::Lookup(const string& name, const string& pwd){
+    if(!isOpen_)return MISS;
+    Shard& shard = ShardOf_(name);
+    lock_guard<mutex> locker(shard.mtx);
+    auto it = shard.index.find(name);
+    if(it == shard.index.end()){
+        misses_++;
+        return MISS;
+    }
+    Entry& entry = *it->second;
+    if(entry.expire <= Clock::now()){
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+        misses_++;
+        return MISS;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    hits_++;
+    if(!entry.exists)return NO_USER;
+    return entry.hash == Hash_(pwd) ? MATCH : MISMATCH;
+}
+
+void AuthCache::Put(const string& name, const string& pwd){
+    if(!isOpen_)return;
+    Insert_(name, Hash_(pwd), true, ttlMs_);
+}
+
+void AuthCache::PutNoUser(const string& name){
+    if(!isOpen_ || negativeTtlMs_ <= 0)return;
+    Insert_(name, 0, false, negativeTtlMs_);
+}
+
+void AuthCache::Insert_(const string& name, uint64_t hash, bool exists, int ttlMs){
+    Shard& shard = ShardOf_(name);
+    lock_guard<mutex> locker(shard.mtx);
+    auto it = shard.index.find(name);
+    if(it != shard.index.end()){
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+    shard.lru.push_front(Entry{name, hash, exists, Clock::now() + chrono::milliseconds(ttlMs)});
+    shard.index[name] = shard.lru.begin();
+    while(shard.lru.size() > shardCapacity_){
+        shard.index.erase(shard.lru.back().name);
+        shard.lru.pop_back();
+    }
+}
+
+void AuthCache::Invalidate(const string& name){
+    Shard& shard = ShardOf_(name);
+    lock_guard<mutex> locker(shard.mtx);
+    auto it = shard.index.find(name);
+    if(it != shard.index.end()){
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef AUTH_CACHE_H
+#define AUTH_CACHE_H
+
+#include <string>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+
+#include "../log/log.h"
+
+//用户凭据的进程内缓存：登录风暴时相同的用户名不再每次都查数据库。
+//只保存密码的带盐哈希，不保存明文；查无此人的结果也缓存(时间更短)，注册成功时显式失效
+class AuthCache{
+public:
+    enum RESULT{
+        MISS,           //没有缓存或已过期，需要查数据库
+        MATCH,          //用户存在且密码一致
+        MISMATCH,       //用户存在但密码不一致
+        NO_USER,        //缓存了查无此人
+    };
+
+    static AuthCache* Instance();
+
+    //capacity为缓存的用户数上限，为0时关闭；ttlMs为存在的用户的有效期，negativeTtlMs为查无此人的有效期
+    bool Init(size_t capacity, int ttlMs, int negativeTtlMs = 5000);
+    void Close();
+    bool IsOpen() const { return isOpen_; }
+
+    RESULT Lookup(const std::string& name, const std::string& pwd);
+    void Put(const std::string& name, const std::string& pwd);     //数据库里查到的用户和密码
+    void PutNoUser(const std::string& name);
+    void Invalidate(const std::string& name);
+
+    uint64_t Hits() const { return hits_; }
+    uint64_t Misses() const { return misses_; }
+
+private:
+    AuthCache();
+    ~AuthCache();
+
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry{
+        std::string name;
+        uint64_t hash;          //密码的哈希，exists为false时无意义
+        bool exists;
+        Clock::time_point expire;
+    };
+
+    struct Shard{
+        std::mutex mtx;
+        std::list<Entry> lru;   //表头为最近使用
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    };
+
+    Shard& ShardOf_(const std::string& name);
+    uint64_t Hash_(const std::string& pwd) const;
+    void Insert_(const std::string& name, uint64_t hash, bool exists, int ttlMs);
+
+    static const int SHARD_NUM = 16;
+
+    size_t shardCapacity_;
+    int ttlMs_;
+    int negativeTtlMs_;
+    uint64_t salt_;             //每次启动随机，哈希不能跨进程比对
+    std::atomic<bool> isOpen_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    Shard shards_[SHARD_NUM];
+};
+
+#endif
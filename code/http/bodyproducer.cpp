@@ -0,0 +1,82 @@
+#include "bodyproducer.h"
+
+using namespace std;
+
+DirListProducer::DirListProducer(const string& dir, const string& reqPath):
+    dp_(opendir(dir.data())), reqPath_(reqPath), started_(false){
+    if(reqPath_.empty() || reqPath_.back() != '/'){
+        reqPath_ += '/';
+    }
+}
+
+DirListProducer::~DirListProducer(){
+    if(dp_)closedir(dp_);
+}
+
+bool DirListProducer::Produce(Buffer& buff, size_t maxBytes){
+    size_t start = buff.ReadableBytes();
+    if(!started_){
+        started_ = true;
+        buff.Append("<html><head><title>Index of ");
+        AppendEscaped_(buff, reqPath_.data());
+        buff.Append("</title></head><body><h1>Index of ");
+        AppendEscaped_(buff, reqPath_.data());
+        buff.Append("</h1><hr><pre>\n");
+    }
+    //一次只读够maxBytes左右的目录项，剩下的等下一次拉取
+    while(dp_ && buff.ReadableBytes() - start < maxBytes){
+        struct dirent* ent = readdir(dp_);
+        if(!ent){
+            closedir(dp_);
+            dp_ = nullptr;
+            break;
+        }
+        if(strcmp(ent->d_name, ".") == 0)continue;
+        bool isParent = strcmp(ent->d_name, "..") == 0;
+        if(isParent && reqPath_ == "/")continue;
+        bool isDir = ent->d_type == DT_DIR;
+        buff.Append("<a href=\"");
+        if(isParent){
+            //请求路径里不允许..段，直接链到上一级目录
+            string parent = reqPath_.substr(0, reqPath_.rfind('/', reqPath_.size() - 2) + 1);
+            AppendUrlEncoded_(buff, parent.data());
+        }else{
+            AppendUrlEncoded_(buff, reqPath_.data());
+            AppendUrlEncoded_(buff, ent->d_name);
+            if(isDir)buff.Append("/", 1);
+        }
+        buff.Append("\">");
+        AppendEscaped_(buff, ent->d_name);
+        if(isDir)buff.Append("/", 1);
+        buff.Append("</a>\n");
+    }
+    if(dp_)return true;
+    buff.Append("</pre><hr></body></html>\n");
+    return false;
+}
+
+void DirListProducer::AppendEscaped_(Buffer& buff, const char* str){
+    for(const char* p = str; *p; p++){
+        switch(*p){
+        case '&': buff.Append("&amp;"); break;
+        case '<': buff.Append("&lt;"); break;
+        case '>': buff.Append("&gt;"); break;
+        case '"': buff.Append("&quot;"); break;
+        default: buff.Append(p, 1); break;
+        }
+    }
+}
+
+//链接里的名字按百分号编码，只保留不需要转义的字符和/，也就不再需要html转义
+void DirListProducer::AppendUrlEncoded_(Buffer& buff, const char* str){
+    static const char HEX[] = "0123456789ABCDEF";
+    for(const char* p = str; *p; p++){
+        unsigned char ch = *p;
+        if(isalnum(ch) || strchr("-._~/", ch)){
+            buff.Append(p, 1);
+        }else{
+            char esc[3] = {'%', HEX[ch >> 4], HEX[ch & 15]};
+            buff.Append(esc, 3);
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef BODY_PRODUCER_H
+#define BODY_PRODUCER_H
+
+#include <string>
+#include <memory>
+#include <dirent.h>
+#include <ctype.h>
+
+#include "../buffer/buffer.h"
+
+//流式响应的正文来源，由HttpConn在socket可写、上一段发完后才拉取下一段，
+//所以慢客户端不会让整个正文堆在内存里
+class BodyProducer{
+public:
+    virtual ~BodyProducer() = default;
+    //向buff追加大约maxBytes字节(可以少)的正文；返回false表示正文结束。
+    //返回true时至少要追加1字节
+    virtual bool Produce(Buffer& buff, size_t maxBytes) = 0;
+    virtual std::string ContentType() const { return "text/html"; }
+};
+
+typedef std::shared_ptr<BodyProducer> ProducerPtr;
+
+//目录列表，边读目录边生成html
+class DirListProducer: public BodyProducer{
+public:
+    //dir为目录的完整路径，reqPath为请求路径，用来拼链接
+    DirListProducer(const std::string& dir, const std::string& reqPath);
+    ~DirListProducer();
+
+    bool IsOpen() const { return dp_ != nullptr; }
+    bool Produce(Buffer& buff, size_t maxBytes) override;
+
+private:
+    static void AppendEscaped_(Buffer& buff, const char* str);
+    static void AppendUrlEncoded_(Buffer& buff, const char* str);
+
+    DIR* dp_;
+    std::string reqPath_;
+    bool started_;
+};
+
+#endif
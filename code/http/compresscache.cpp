@@ -0,0 +1,146 @@
+#include "compresscache.h"
+
+using namespace std;
+
+CompressCache* CompressCache::Instance(){
+    static CompressCache cache;
+    return &cache;
+}
+
+CompressCache::CompressCache():shardCapacity_(0), level_(Z_DEFAULT_COMPRESSION), isOpen_(false),
+    hits_(0), misses_(0), compressed_(0){}
+
+CompressCache::~CompressCache(){
+    Close();
+}
+
+bool CompressCache::Init(size_t capacity, int level, int threadNum){
+    Close();
+    if(capacity == 0)return false;
+    shardCapacity_ = (capacity + SHARD_NUM - 1) / SHARD_NUM;
+    level_ = level;
+    hits_ = misses_ = compressed_ = 0;
+    pool_.reset(new ThreadPool(threadNum > 0 ? threadNum : 1));
+    isOpen_ = true;
+    return true;
+}
+
+void CompressCache::Close(){
+    if(isOpen_){
+        LOG_INFO("CompressCache hits: %llu, misses: %llu, compressed: %llu",
+            (unsigned long long)hits_, (unsigned long long)misses_, (unsigned long long)compressed_);
+    }
+    isOpen_ = false;
+    if(pool_){
+        pool_->Close();
+        pool_.reset();
+    }
+    for(auto& shard: shards_){
+        lock_guard<mutex> locker(shard.mtx);
+        shard.index.clear();
+        shard.lru.clear();
+        shard.pending.clear();
+        shard.bytes = 0;
+    }
+}
+
+string CompressCache::Key_(const struct stat& st, ENCODING encoding){
+    char key[96];
+    snprintf(key, sizeof(key), "%d:%llx:%llx:%lld.%09ld:%llx", (int)encoding,
+        (unsigned long long)st.st_dev, (unsigned long long)st.st_ino,
+        (long long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec, (unsigned long long)st.st_size);
+    return key;
+}
+
+CompressCache::Shard& CompressCache::ShardOf_(const string& key){
+    return shards_[hash<string>()(key) % SHARD_NUM];
+}
+
+ResponseBlob CompressCache::Get(const FilePtr& file, ENCODING encoding, bool* pending){
+    if(pending)*pending = false;
+    if(!isOpen_ || !file || file->st.st_size < MIN_SIZE || file->st.st_size > MAX_SIZE)return nullptr;
+    if(!file->mmFile && file->fd < 0)return nullptr;
+    string key = Key_(file->st, encoding);
+    Shard& shard = ShardOf_(key);
+    {
+        lock_guard<mutex> locker(shard.mtx);
+        auto it = shard.index.find(key);
+        if(it != shard.index.end()){
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            hits_++;
+            return it->second->blob;
+        }
+        misses_++;
+        if(pending)*pending = true;
+        if(!shard.pending.insert(key).second){
+            return nullptr;//已经有任务在压缩
+        }
+    }
+    //任务持有file，压缩期间文件不会被关闭或解除映射
+    pool_->AddTask([this, file, encoding, key]{
+        Finish_(key, Compress_(*file, encoding));
+    });
+    return nullptr;
+}
+
+void CompressCache::Finish_(const string& key, const ResponseBlob& blob){
+    Shard& shard = ShardOf_(key);
+    lock_guard<mutex> locker(shard.mtx);
+    shard.pending.erase(key);
+    //压缩失败或没有变小时也缓存一个空结果，这个文件之后直接按原样发送，不再反复压缩
+    size_t size = EntrySize_(key, blob);
+    if(!isOpen_ || size > shardCapacity_ || shard.index.count(key))return;
+    if(blob)compressed_++;
+    shard.lru.push_front(Entry{key, blob});
+    shard.index[key] = shard.lru.begin();
+    shard.bytes += size;
+    while(shard.bytes > shardCapacity_){
+        shard.bytes -= EntrySize_(shard.lru.back().key, shard.lru.back().blob);
+        shard.index.erase(shard.lru.back().key);
+        shard.lru.pop_back();
+    }
+}
+
+ResponseBlob CompressCache::Compress_(const FileEntry& file, ENCODING encoding) const{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    //windowBits加16输出gzip格式，否则为zlib格式(HTTP的deflate编码)
+    int windowBits = encoding == GZIP ? 15 + 16 : 15;
+    if(deflateInit2(&zs, level_, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK){
+        return nullptr;
+    }
+    size_t size = file.st.st_size;
+    shared_ptr<string> out = make_shared<string>();
+    out->resize(deflateBound(&zs, size));
+    zs.next_out = (Bytef*)&(*out)[0];
+    zs.avail_out = out->size();
+
+    int ret = Z_OK;
+    if(file.mmFile){
+        zs.next_in = (Bytef*)file.mmFile;
+        zs.avail_in = size;
+        ret = deflate(&zs, Z_FINISH);
+    }else{
+        char buf[16 * 1024];
+        off_t offset = 0;
+        while(ret == Z_OK){
+            size_t want = size - offset < sizeof(buf) ? size - offset : sizeof(buf);
+            ssize_t n = pread(file.fd, buf, want, offset);
+            if(n <= 0){
+                ret = Z_ERRNO;//文件在读取过程中被截断
+                break;
+            }
+            offset += n;
+            zs.next_in = (Bytef*)buf;
+            zs.avail_in = n;
+            ret = deflate(&zs, (size_t)offset >= size ? Z_FINISH : Z_NO_FLUSH);
+        }
+    }
+    deflateEnd(&zs);
+    if(ret != Z_STREAM_END || zs.total_out >= size){
+        return nullptr;//压缩失败或没有变小
+    }
+    out->resize(zs.total_out);
+    out->shrink_to_fit();
+    return out;
+}
@@ -0,0 +1,84 @@
+#ifndef COMPRESS_CACHE_H
+#define COMPRESS_CACHE_H
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <zlib.h>
+
+#include "filecache.h"
+#include "responsecache.h"
+#include "../log/log.h"
+#include "../pool/threadpool.h"
+
+//即时压缩结果的缓存：同一个文件(设备号+inode+修改时间+大小)的每种编码只压缩一次，
+//文件内容变了键也随之变化，旧结果按LRU自然淘汰。
+//未命中时不在事件循环里压缩：交给自己的线程池压缩，这次先按原样发送，压缩完成后放进缓存；
+//同一个键同时只有一个压缩任务
+class CompressCache{
+public:
+    enum ENCODING{
+        GZIP = 0,
+        DEFLATE,
+    };
+
+    static CompressCache* Instance();
+
+    //capacity为缓存的压缩结果总字节数上限，为0时关闭即时压缩；threadNum为压缩线程数
+    bool Init(size_t capacity, int level = 6, int threadNum = 1);
+    void Close();       //等正在执行的压缩任务完成
+    bool IsOpen() const { return isOpen_; }
+
+    //返回file的压缩结果；未命中(已开始后台压缩)、文件太小、太大或压缩失败时返回空，调用方按原样发送。
+    //pending不为空时，返回空是因为还在后台压缩(之后再请求会有结果)则置为true
+    ResponseBlob Get(const FilePtr& file, ENCODING encoding, bool* pending = nullptr);
+
+    uint64_t Hits() const { return hits_; }
+    uint64_t Misses() const { return misses_; }
+    uint64_t Compressed() const { return compressed_; }
+
+    static const off_t MIN_SIZE = 256;               //再小压缩也省不了几个字节
+    static const off_t MAX_SIZE = 4 * 1024 * 1024;   //更大的文件压缩太久、占内存太多
+
+private:
+    CompressCache();
+    ~CompressCache();
+
+    struct Entry{
+        std::string key;
+        ResponseBlob blob;
+    };
+
+    struct Shard{
+        std::mutex mtx;
+        size_t bytes = 0;
+        std::list<Entry> lru;       //表头为最近使用，blob为空表示压缩不划算
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        std::unordered_set<std::string> pending;    //正在压缩的键
+    };
+
+    static std::string Key_(const struct stat& st, ENCODING encoding);
+    static size_t EntrySize_(const std::string& key, const ResponseBlob& blob){
+        return blob ? blob->size() : key.size();
+    }
+    Shard& ShardOf_(const std::string& key);
+    ResponseBlob Compress_(const FileEntry& file, ENCODING encoding) const;
+    void Finish_(const std::string& key, const ResponseBlob& blob);  //压缩任务完成，在压缩线程上调用
+
+    static const int SHARD_NUM = 16;
+
+    size_t shardCapacity_;
+    int level_;
+    std::atomic<bool> isOpen_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> compressed_;
+    Shard shards_[SHARD_NUM];
+    std::unique_ptr<ThreadPool> pool_;
+};
+
+#endif
@@ -0,0 +1,242 @@
+#include "filecache.h"
+#include "httpresponse.h"
+
+using namespace std;
+
+FileCache* FileCache::Instance(){
+    static FileCache cache;
+    return &cache;
+}
+
+FileCache::FileCache():shardCapacity_(0), mapFiles_(false), hashETag_(false), isOpen_(false),
+    inotifyFd_(-1), stopFd_(-1){}
+
+FileCache::~FileCache(){
+    Close();
+}
+
+bool FileCache::Init(const string& srcDir, size_t capacity, bool mapFiles, bool hashETag){
+    Close();
+    if(capacity == 0)return false;
+    srcDir_ = srcDir;
+    mapFiles_ = mapFiles;
+    hashETag_ = hashETag;
+    shardCapacity_ = (capacity + SHARD_NUM - 1) / SHARD_NUM;
+
+    //没有inotify就无法感知文件变化，宁可不缓存也不返回旧内容
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(inotifyFd_ < 0 || stopFd_ < 0){
+        LOG_ERROR("FileCache inotify init error: %s", strerror(errno));
+        Close();
+        return false;
+    }
+    AddWatch_("");
+    isOpen_ = true;
+    watchThread_ = thread(&FileCache::WatchThread_, this);
+    LOG_INFO("FileCache capacity: %d, mmap: %s, hash ETag: %s", (int)capacity,
+        mapFiles ? "true" : "false", hashETag ? "true" : "false");
+    return true;
+}
+
+void FileCache::Close(){
+    isOpen_ = false;
+    if(watchThread_.joinable()){
+        uint64_t one = 1;
+        ssize_t n = ::write(stopFd_, &one, sizeof(one));
+        (void)n;
+        watchThread_.join();
+    }
+    if(inotifyFd_ >= 0){
+        close(inotifyFd_);
+        inotifyFd_ = -1;
+    }
+    if(stopFd_ >= 0){
+        close(stopFd_);
+        stopFd_ = -1;
+    }
+    watchDir_.clear();
+    Clear();
+}
+
+FileCache::Shard& FileCache::ShardOf_(const string& path){
+    return shards_[hash<string>()(path) % SHARD_NUM];
+}
+
+FilePtr FileCache::Get(const string& path){
+    if(!isOpen_)return nullptr;
+    Shard& shard = ShardOf_(path);
+    uint64_t version;
+    {
+        lock_guard<mutex> locker(shard.mtx);
+        auto it = shard.index.find(path);
+        if(it != shard.index.end()){
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return it->second->second;
+        }
+        version = shard.version;
+    }
+
+    //未命中：在锁外做stat/open/mmap
+    FilePtr entry = Load_(path);
+    lock_guard<mutex> locker(shard.mtx);
+    if(shard.version != version){
+        //加载期间目录有变化，这次的结果不进缓存
+        return entry;
+    }
+    auto it = shard.index.find(path);
+    if(it != shard.index.end()){
+        return it->second->second;
+    }
+    shard.lru.emplace_front(path, entry);
+    shard.index[path] = shard.lru.begin();
+    if(shard.lru.size() > shardCapacity_){
+        shard.index.erase(shard.lru.back().first);
+        shard.lru.pop_back();
+    }
+    return entry;
+}
+
+FilePtr FileCache::Load_(const string& path) const{
+    shared_ptr<FileEntry> entry = make_shared<FileEntry>();
+    string fullPath = srcDir_ + path;
+    entry->mime = HttpResponse::FileType(path);
+    if(stat(fullPath.data(), &entry->st) < 0){
+        //不存在的路径也缓存下来，创建文件时由inotify失效
+        entry->st = {0};
+        return entry;
+    }
+    entry->exists = true;
+    if(S_ISREG(entry->st.st_mode) && (entry->st.st_mode & S_IROTH)){
+        entry->fd = open(fullPath.data(), O_RDONLY | O_CLOEXEC);
+        if(entry->fd >= 0 && mapFiles_ && entry->st.st_size > 0){
+            void* mmRet = mmap(0, entry->st.st_size, PROT_READ, MAP_PRIVATE, entry->fd, 0);
+            if(mmRet != MAP_FAILED){
+                entry->mmFile = (char*)mmRet;
+            }
+        }
+        if(entry->fd >= 0 && hashETag_ && entry->st.st_size <= MAX_HASH_SIZE){
+            entry->etag = HashETag_(*entry);
+        }
+        if(entry->etag.empty()){
+            entry->etag = HttpResponse::StatETag(entry->st);
+        }
+    }
+    return entry;
+}
+
+//内容的FNV-1a哈希：文件被touch或重新部署但内容不变时ETag也不变
+string FileCache::HashETag_(const FileEntry& entry){
+    uint64_t hash = 14695981039346656037ULL;
+    auto update = [&hash](const char* data, size_t len){
+        for(size_t i = 0; i < len; i++){
+            hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+        }
+    };
+    if(entry.mmFile){
+        update(entry.mmFile, entry.st.st_size);
+    }else{
+        char buf[16 * 1024];
+        off_t offset = 0;
+        while(offset < entry.st.st_size){
+            ssize_t n = pread(entry.fd, buf, sizeof(buf), offset);
+            if(n <= 0)return "";
+            update(buf, n);
+            offset += n;
+        }
+    }
+    char etag[32];
+    snprintf(etag, sizeof(etag), "\"%016llx\"", (unsigned long long)hash);
+    return etag;
+}
+
+void FileCache::Invalidate(const string& path){
+    Shard& shard = ShardOf_(path);
+    lock_guard<mutex> locker(shard.mtx);
+    shard.version++;
+    auto it = shard.index.find(path);
+    if(it != shard.index.end()){
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+}
+
+void FileCache::Clear(){
+    for(auto& shard: shards_){
+        lock_guard<mutex> locker(shard.mtx);
+        shard.version++;
+        shard.index.clear();
+        shard.lru.clear();
+    }
+}
+
+//监听目录及其子目录，dir为相对srcDir的目录，根目录为""
+void FileCache::AddWatch_(const string& dir){
+    string fullPath = srcDir_ + dir;
+    int wd = inotify_add_watch(inotifyFd_, fullPath.data(),
+        IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+        IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+    if(wd < 0){
+        LOG_WARN("FileCache watch %s error: %s", fullPath.data(), strerror(errno));
+        return;
+    }
+    watchDir_[wd] = dir;
+
+    DIR* dp = opendir(fullPath.data());
+    if(!dp)return;
+    while(struct dirent* ent = readdir(dp)){
+        if(ent->d_type == DT_DIR && strcmp(ent->d_name, ".") && strcmp(ent->d_name, "..")){
+            AddWatch_(dir + "/" + ent->d_name);
+        }
+    }
+    closedir(dp);
+}
+
+void FileCache::WatchThread_(){
+    struct pollfd fds[2];
+    fds[0].fd = inotifyFd_;
+    fds[0].events = POLLIN;
+    fds[1].fd = stopFd_;
+    fds[1].events = POLLIN;
+    while(isOpen_){
+        int ret = poll(fds, 2, -1);
+        if(ret < 0 && errno != EINTR)break;
+        if(fds[1].revents & POLLIN)break;
+        if(fds[0].revents & POLLIN)HandleEvents_();
+    }
+}
+
+void FileCache::HandleEvents_(){
+    alignas(struct inotify_event) char buf[4096];
+    while(true){
+        ssize_t len = ::read(inotifyFd_, buf, sizeof(buf));
+        if(len <= 0)return;
+        for(char* ptr = buf; ptr < buf + len;){
+            struct inotify_event* event = (struct inotify_event*)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+            if(event->mask & IN_Q_OVERFLOW){
+                //事件丢失，无法确定哪些文件变了，整体清空
+                LOG_WARN("FileCache inotify overflow, clear all");
+                Clear();
+                continue;
+            }
+            auto it = watchDir_.find(event->wd);
+            if(it == watchDir_.end())continue;
+            string dir = it->second;
+            if(event->mask & IN_IGNORED){
+                watchDir_.erase(it);
+                continue;
+            }
+            if(event->len == 0)continue;
+            string path = dir + "/" + event->name;
+            LOG_DEBUG("FileCache invalidate %s", path.data());
+            Invalidate(path);
+            if((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))){
+                AddWatch_(path);
+            }else if((event->mask & IN_ISDIR) && (event->mask & (IN_DELETE | IN_MOVED_FROM))){
+                //整个子目录被移走，前缀下的缓存无法逐个定位，清空
+                Clear();
+            }
+        }
+    }
+}
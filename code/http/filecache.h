@@ -0,0 +1,93 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+
+#include "../log/log.h"
+
+//缓存一个资源文件的元数据和打开的fd，只读共享；
+//响应通过shared_ptr持有，缓存失效后正在发送的响应仍然安全，最后一个持有者释放时才close/munmap
+struct FileEntry{
+    FileEntry():exists(false), fd(-1), mmFile(nullptr){ st = {0}; }
+    ~FileEntry(){
+        if(mmFile)munmap(mmFile, st.st_size);
+        if(fd >= 0)close(fd);
+    }
+    FileEntry(const FileEntry&) = delete;
+    FileEntry& operator=(const FileEntry&) = delete;
+
+    bool exists;        //stat是否成功
+    int fd;             //普通文件且有读权限时打开，否则为-1
+    char* mmFile;       //开启映射时为长期有效的只读映射
+    struct stat st;
+    std::string mime;
+    std::string etag;   //普通文件的ETag，加载时生成一次
+};
+
+typedef std::shared_ptr<const FileEntry> FilePtr;
+
+//资源目录的 打开文件 + 元数据 缓存，按路径分片的LRU，用inotify监听目录变化来失效
+class FileCache{
+public:
+    static FileCache* Instance();
+
+    //capacity为缓存的文件数上限，为0时关闭缓存；mapFiles为true时顺便建立长期mmap映射；
+    //hashETag为true时不超过MAX_HASH_SIZE的文件用内容哈希做ETag，否则用mtime和大小
+    bool Init(const std::string& srcDir, size_t capacity, bool mapFiles, bool hashETag = false);
+    void Close();
+    bool IsOpen() const { return isOpen_; }
+
+    FilePtr Get(const std::string& path);   //path形如 "/index.html"
+    void Invalidate(const std::string& path);
+    void Clear();
+
+private:
+    FileCache();
+    ~FileCache();
+
+    struct Shard{
+        std::mutex mtx;
+        uint64_t version = 0;    //每次失效都加一，用于丢弃查找期间已过期的结果
+        std::list<std::pair<std::string, FilePtr>> lru;   //表头为最近使用
+        std::unordered_map<std::string, std::list<std::pair<std::string, FilePtr>>::iterator> index;
+    };
+
+    Shard& ShardOf_(const std::string& path);
+    FilePtr Load_(const std::string& path) const;
+    static std::string HashETag_(const FileEntry& entry);
+
+    void AddWatch_(const std::string& dir);
+    void WatchThread_();
+    void HandleEvents_();
+
+    static const int SHARD_NUM = 16;
+    static const off_t MAX_HASH_SIZE = 1024 * 1024;
+
+    std::string srcDir_;        //不带末尾的'/'
+    size_t shardCapacity_;
+    bool mapFiles_;
+    bool hashETag_;
+    std::atomic<bool> isOpen_;
+    Shard shards_[SHARD_NUM];
+
+    int inotifyFd_;
+    int stopFd_;
+    std::unordered_map<int, std::string> watchDir_;   //wd -> 相对目录，根目录为""
+    std::thread watchThread_;
+};
+
+#endif
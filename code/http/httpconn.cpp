@@ -4,15 +4,26 @@ using namespace std;
 const char*HttpConn::srcDir;
 atomic<int>HttpConn::userCount;
 bool HttpConn::isET;
+int HttpConn::timeoutMs[HttpConn::TIMER_KIND_NUM];
 
 HttpConn::HttpConn(){
     fd_ = -1;
     addr_ = {0};
     isClose_ = true;
+    isKeepAlive_ = false;
+    encodings_ = 0;
+    verify_ = VERIFY_IDLE;
+    toWriteBytes_ = 0;
+    buffQueued_ = 0;
+    pipeFd_[0] = pipeFd_[1] = -1;
+    pipeBytes_ = 0;
+    useSplice_ = false;
+    timer_.data = this;
 }
 
 HttpConn::~HttpConn(){
     Close();
+    ClosePipe_();
 }
 
 void HttpConn::init(int fd, const sockaddr_in& addr){
@@ -22,12 +33,30 @@ void HttpConn::init(int fd, const sockaddr_in& addr){
     fd_ = fd;
     writeBuff_.RetrieveAll();
     readBuff_.RetrieveAll();
+    request_.Init();
+    out_.clear();
+    toWriteBytes_ = 0;
+    buffQueued_ = 0;
+    isKeepAlive_ = false;
+    verify_ = VERIFY_IDLE;
     isClose_ = false;
     LOG_INFO("Client[%d](%s:%d) in, UserCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
 }
 
 void HttpConn::Close(){
     response_.UnmapFile();
+    out_.clear();
+    toWriteBytes_ = 0;
+    buffQueued_ = 0;
+    //连接槽会一直保留着HttpConn，缓冲区的内存要还回去
+    readBuff_.RetrieveAll();
+    writeBuff_.RetrieveAll();
+    streamBuff_.RetrieveAll();
+    ReleaseBuffers_();
+    if(pipeBytes_ > 0){
+        //管道里残留上一个连接的数据，不能复用
+        ClosePipe_();
+    }
     if(isClose_ == false){
         isClose_ = true;
         userCount--;
@@ -36,6 +65,15 @@ void HttpConn::Close(){
     }
 }
 
+HttpConn::TIMER_KIND HttpConn::TimerKind()const{
+    if(toWriteBytes_ > 0)return WRITE_TIMER;
+    HttpRequest::PARSE_STATE state = request_.State();
+    if(state >= HttpRequest::BODY && state < HttpRequest::FINISH)return BODY_TIMER;
+    //请求行或头部只到了一部分(行不完整时数据还留在readBuff_里)
+    if(state == HttpRequest::HEADERS || readBuff_.ReadableBytes() > 0)return HEADER_TIMER;
+    return IDLE_TIMER;
+}
+
 int HttpConn::GetFd()const{
     return fd_;
 }
@@ -64,52 +102,416 @@ ssize_t HttpConn::read(int* saveErrno){
 ssize_t HttpConn::write(int* saveErrno){
     ssize_t len = -1;
     do{
-        len = writev(fd_, iov_, iovCnt_);
+        if(out_.empty()){
+            break;//所有数据都已经写入了
+        }else if(out_.front().type == OutSeg::FILE){
+            len = WriteFile_();
+        }else{
+            len = WriteIov_();
+        }
         if(len <= 0){
             *saveErrno = errno;
             break;
         }
-        if(iov_[0].iov_len + iov_[1].iov_len == 0)break;//所有数据都已经写入了
-        else if(static_cast<size_t>(len) > iov_[0].iov_len){//第一个缓冲区已经全部写入，第二个部分写入
-            iov_[1].iov_base = (uint8_t*)iov_[1].iov_base + (len - iov_[0].iov_len);
-            iov_[1].iov_len -= (len - iov_[0].iov_len);
-            if(iov_[0].iov_len){
-                writeBuff_.RetrieveAll();
-                iov_[0].iov_len = 0;
-            }
+    }while(isET || ToWriteBytes() > 10240);
+    if(out_.empty()){
+        writeBuff_.RetrieveAll();
+        buffQueued_ = 0;
+        ReleaseBuffers_();
+    }
+    return len;
+}
+
+//空闲(没有要发的数据、读缓冲区也空了)时把缓冲区还给BufferPool，有数据时才再借
+void HttpConn::ReleaseBuffers_(){
+    readBuff_.Release();
+    writeBuff_.Release();
+    streamBuff_.Release();
+}
+
+//把队首连续的内存段(响应头、mmap、缓存的响应)合并成一次writev
+ssize_t HttpConn::WriteIov_(){
+    struct iovec iov[MAX_IOV];
+    int cnt = 0;
+    size_t buffOff = 0;
+    bool more = false;
+    for(const OutSeg& seg: out_){
+        if(seg.type == OutSeg::FILE || cnt == MAX_IOV){
+            more = true;
+            break;
+        }
+        if(seg.type == OutSeg::BUFF){
+            iov[cnt].iov_base = const_cast<char*>(writeBuff_.Peek()) + buffOff;
+            buffOff += seg.len;
+        }else if(seg.type == OutSeg::STREAM){
+            iov[cnt].iov_base = const_cast<char*>(streamBuff_.Peek());
         }else{
-            iov_[0].iov_base = (uint8_t*)iov_[0].iov_base + len;
-            iov_[0].iov_len -= len;
-            writeBuff_.Retrieve(len);
+            iov[cnt].iov_base = const_cast<char*>(seg.data);
         }
-    }while(isET || ToWriteBytes() > 10240);
+        iov[cnt].iov_len = seg.len;
+        cnt++;
+    }
+    struct msghdr msg = {0};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = cnt;
+    //后面紧跟sendfile等数据时用MSG_MORE，让内核把响应头和文件的第一段合并成满包再发
+    ssize_t len = sendmsg(fd_, &msg, more ? MSG_MORE | MSG_NOSIGNAL : MSG_NOSIGNAL);
+    if(len > 0){
+        Consume_(len);
+    }
     return len;
 }
 
+//从队首开始扣掉已经发送的len个内存字节
+void HttpConn::Consume_(size_t len){
+    while(len > 0){
+        assert(!out_.empty() && out_.front().type != OutSeg::FILE);
+        OutSeg& seg = out_.front();
+        size_t n = len < seg.len ? len : seg.len;
+        if(seg.type == OutSeg::BUFF){
+            writeBuff_.Retrieve(n);
+            buffQueued_ -= n;
+        }else if(seg.type == OutSeg::STREAM){
+            streamBuff_.Retrieve(n);
+        }else{
+            seg.data += n;
+        }
+        seg.len -= n;
+        len -= n;
+        toWriteBytes_ -= n;
+        if(seg.len == 0){
+            if(seg.type == OutSeg::STREAM && !seg.eof){
+                //上一段已被socket接收，才拉取下一段：发送速度决定生成速度
+                FillStream_(seg);
+            }else{
+                out_.pop_front();
+            }
+        }
+    }
+}
+
+//发送队首的文件段，sendfile不支持的源(非普通文件等)自动退回splice
+ssize_t HttpConn::WriteFile_(){
+    if(useSplice_ || HttpResponse::sendMode == HttpResponse::SPLICE){
+        return SpliceFile_();
+    }
+    OutSeg& seg = out_.front();
+    ssize_t len = sendfile(fd_, seg.fd, &seg.offset, seg.len);
+    if(len < 0 && (errno == EINVAL || errno == ENOSYS)){
+        LOG_DEBUG("Client[%d] sendfile unsupported, fallback to splice", fd_);
+        useSplice_ = true;
+        return SpliceFile_();
+    }
+    if(len == 0){
+        //文件被截断，剩余部分已经发不出来了
+        errno = EPIPE;
+        return -1;
+    }
+    if(len > 0){
+        seg.len -= len;
+        toWriteBytes_ -= len;
+        if(seg.len == 0)out_.pop_front();
+    }
+    return len;
+}
+
+ssize_t HttpConn::SpliceFile_(){
+    if(pipeFd_[0] < 0 && pipe2(pipeFd_, O_NONBLOCK | O_CLOEXEC) < 0){
+        pipeFd_[0] = pipeFd_[1] = -1;
+        return -1;
+    }
+    OutSeg& seg = out_.front();
+    if(pipeBytes_ == 0){
+        //管道空了才从文件灌入，单次不超过管道默认容量，避免写管道阻塞
+        size_t want = seg.len < 65536 ? seg.len : 65536;
+        ssize_t in = splice(seg.fd, &seg.offset, pipeFd_[1], nullptr, want,
+                            SPLICE_F_MOVE | SPLICE_F_MORE);
+        if(in <= 0){
+            if(in == 0)errno = EPIPE;
+            return -1;
+        }
+        pipeBytes_ = in;
+    }
+    ssize_t len = splice(pipeFd_[0], nullptr, fd_, nullptr, pipeBytes_,
+                         SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE);
+    if(len > 0){
+        pipeBytes_ -= len;
+        seg.len -= len;
+        toWriteBytes_ -= len;
+        if(seg.len == 0)out_.pop_front();
+    }
+    return len;
+}
+
+void HttpConn::ClosePipe_(){
+    if(pipeFd_[0] >= 0){
+        close(pipeFd_[0]);
+        close(pipeFd_[1]);
+        pipeFd_[0] = pipeFd_[1] = -1;
+    }
+    pipeBytes_ = 0;
+}
+
+//处理读缓冲区里所有完整的请求(HTTP/1.1流水线)，响应按顺序排进out_，由一次write批量发出；
+//不完整的请求留在readBuff_里等下次读
 bool HttpConn::process(){
-    request_.Init();
-    if(readBuff_.ReadableBytes() <= 0){
+    if(verify_ != VERIFY_IDLE)return false;
+    int responses = 0;
+    while(responses < MAX_PIPELINE){
+        HttpRequest::PARSE_RESULT ret = HttpRequest::PARSE_OK;
+        HttpRequest::VERIFY_STATE verify = request_.VerifyState();
+        if(verify == HttpRequest::VERIFY_PENDING){
+            //前面的响应发完之后才查询，查询期间连接不归任何线程，回来时也不会和写冲突
+            if(out_.empty())verify_ = VERIFY_READY;
+            break;
+        }
+        if(verify == HttpRequest::VERIFY_NONE){
+            if(readBuff_.ReadableBytes() == 0)break;
+            ret = request_.parse(readBuff_);
+            if(ret == HttpRequest::PARSE_OK && request_.VerifyState() == HttpRequest::VERIFY_PENDING){
+                continue;
+            }
+        }
+        if(ret == HttpRequest::PARSE_AGAIN){
+            //请求还没收完整，已解析的部分保留在request_里，继续等待读事件
+            if(request_.ExpectContinue()){
+                //客户端等100 Continue才发送正文；中间响应不会关闭连接
+                writeBuff_.Append("HTTP/1.1 100 Continue\r\n\r\n");
+                PushBuff_();
+                isKeepAlive_ = true;
+                responses++;
+            }
+            break;
+        }
+        AddResponse_(ret == HttpRequest::PARSE_OK);
+        responses++;
+        if(verify == HttpRequest::VERIFY_DONE){
+            //查询结果已经生成了响应，清掉状态，不然下一轮还会当作待响应的请求
+            request_.Init();
+        }
+        if(!isKeepAlive_){
+            //这个响应之后要关闭连接，后面的请求不再处理
+            readBuff_.RetrieveAll();
+            break;
+        }
+        if(!out_.empty() && out_.back().type == OutSeg::STREAM){
+            //streamBuff_只能给一个流式响应用，后面的请求等它发完再处理
+            break;
+        }
+    }
+    LOG_DEBUG("Client[%d] %d responses, %d bytes to write", fd_, responses, (int)ToWriteBytes());
+    readBuff_.Release();
+    return responses > 0;
+}
+
+bool HttpConn::StartVerify(std::function<void(bool)> done){
+    assert(verify_ == VERIFY_READY && done);
+    const HttpRequest::UserAuth& auth = request_.Auth();
+    std::string name = auth.name, pwd = auth.pwd;
+    bool isLogin = auth.isLogin;
+    if(!DbExecutor::Instance()->IsOpen()){
+        //没有启动执行器(如测试程序)时在当前线程查询
+        verify_ = VERIFY_RUNNING;
+        done(HttpRequest::UserVerify(name, pwd, isLogin));
+        return true;
+    }
+    verify_ = VERIFY_RUNNING;
+    if(!isLogin && RegisterWriter::Instance()->IsOpen()){
+        //注册交给写线程攒批写入
+        if(!RegisterWriter::Instance()->Submit(name, pwd, done)){
+            verify_ = VERIFY_READY;
+            return false;
+        }
+        return true;
+    }
+    if(!DbExecutor::Instance()->Submit([name, pwd, isLogin, done](){
+        done(HttpRequest::UserVerify(name, pwd, isLogin));
+    })){
+        verify_ = VERIFY_READY;
         return false;
-    }else if(request_.parse(readBuff_)){//从readbuff_中解析HTTP请求
+    }
+    return true;
+}
+
+bool HttpConn::FinishVerify(bool ok){
+    assert(verify_ != VERIFY_IDLE);
+    verify_ = VERIFY_IDLE;
+    request_.FinishVerify(ok);
+    return process();
+}
+
+//为刚解析完的请求生成响应并排队
+void HttpConn::AddResponse_(bool parsed){
+    isKeepAlive_ = parsed && request_.IsKeepAlive();
+    if(parsed){//从readbuff_中解析HTTP请求
         LOG_DEBUG("%s", request_.path().c_str());
-        response_.Init(srcDir,request_.path(), request_.IsKeepAlive(), 200);
+        //带Range或条件头的请求响应随请求头变化，不走响应缓存
+        StrSpan range = request_.Header("Range");
+        bool cacheable = range.empty() && request_.Header("If-None-Match").empty() &&
+                         request_.Header("If-Modified-Since").empty();
+        encodings_ = HttpResponse::AcceptEncodings(request_.Header("Accept-Encoding"));
+        ResponseBlob blob;
+        if(cacheable){
+            blob = ResponseCache::Instance()->Get(request_.path(), isKeepAlive_, encodings_);
+        }
+        if(blob){
+            //命中预渲染的响应：直接发送缓存的只读内存
+            OutSeg seg;
+            seg.type = OutSeg::MEM;
+            seg.data = blob->data();
+            seg.len = blob->size();
+            seg.blob = std::move(blob);
+            PushSeg_(std::move(seg));
+            return;
+        }
+        response_.Init(srcDir,request_.path(), isKeepAlive_, 200);
+        response_.SetEncodings(encodings_);
+        if(!cacheable && request_.method() == "GET"){
+            response_.SetConditions(request_.Header("If-None-Match").str(),
+                                    request_.Header("If-Modified-Since").str());
+            if(!range.empty()){
+                response_.SetRange(range.str(), request_.Header("If-Range").str());
+            }
+        }
     }else{
-        response_.Init(srcDir,request_.path(), false, 400);
+        //格式错误或正文超限，剩下的数据已无法定位请求边界，丢弃并在响应后关闭连接
+        readBuff_.RetrieveAll();
+        response_.Init(srcDir,request_.path(), false, request_.ErrorCode());
     }
 
+    size_t start = writeBuff_.ReadableBytes();
     response_.MakeResponse(writeBuff_);
+    PushBuff_();
 
-    //iov_[0] 存储响应报文数据，iov_[1] 存储文件数据
-    iov_[0].iov_base = const_cast<char*>(writeBuff_.Peek());
-    iov_[0].iov_len = writeBuff_.ReadableBytes();
-    iovCnt_ = 1;
+    //文件部分：mmap模式进iov和响应头一起writev，sendfile/splice模式由WriteFile_从fd直接发送
+    if(response_.Ranges().empty()){
+        PushFile_(0, response_.FileLen());
+    }else{
+        //206：只发送请求的各段，多段时每段前是multipart段头
+        for(const HttpResponse::FileRange& range: response_.Ranges()){
+            if(!range.head.empty()){
+                writeBuff_.Append(range.head);
+                PushBuff_();
+            }
+            PushFile_(range.offset, range.len);
+        }
+        if(!response_.RangeTail().empty()){
+            writeBuff_.Append(response_.RangeTail());
+            PushBuff_();
+        }
+    }
+    if(response_.Producer()){
+        //流式正文：先拉第一段，之后每发完一段再拉下一段
+        OutSeg seg;
+        seg.type = OutSeg::STREAM;
+        seg.data = nullptr;
+        seg.len = 0;
+        seg.offset = 0;
+        seg.fd = -1;
+        seg.producer = response_.Producer();
+        seg.chunked = response_.IsChunked();
+        seg.eof = false;
+        PushSeg_(std::move(seg));
+        FillStream_(out_.back());
+    }
+    //只缓存正常解析的完整响应(206/304等随请求头变化)，错误页只缓存404(请求路径不变时才能用它做键)；
+    //压缩还没完成时发的是原样的正文，缓存了以后同样的请求就一直拿不到压缩结果
+    if(parsed && ((response_.Code() == 200 && request_.path() == response_.Path() &&
+                   !response_.CompressPending()) || response_.Code() == 404)){
+        CacheResponse_(start);
+    }
+    //文件的引用已经转给out_，response_可以给下一个请求复用
+    response_.UnmapFile();
+}
 
-    if(response_.FileLen() > 0 && response_.File()){
-        iov_[1].iov_base = response_.File();
-        iov_[1].iov_len = response_.FileLen();
-        iovCnt_ = 2;
+//向producer拉取下一段正文放进streamBuff_，chunked时加上块头尾，结束时追加结束块
+void HttpConn::FillStream_(OutSeg& seg){
+    assert(seg.len == 0 && !seg.eof);
+    streamBuff_.RetrieveAll();
+    //块头用定长十六进制占位，生成后回填，省掉一次拷贝
+    const size_t headLen = seg.chunked ? 10 : 0;
+    if(seg.chunked)streamBuff_.Append("00000000\r\n", headLen);
+    bool more = true;
+    while(more && streamBuff_.ReadableBytes() == headLen){
+        more = seg.producer->Produce(streamBuff_, STREAM_CHUNK);
     }
-    LOG_DEBUG("filesize:%d, %d to %d",response_.FileLen(), iovCnt_, ToWriteBytes());
-    return true;
+    size_t dataLen = streamBuff_.ReadableBytes() - headLen;
+    if(seg.chunked){
+        if(dataLen > 0){
+            char head[24];
+            snprintf(head, sizeof(head), "%08zx", dataLen);
+            memcpy(const_cast<char*>(streamBuff_.Peek()), head, 8);
+            streamBuff_.Append("\r\n", 2);
+        }else{
+            streamBuff_.RetrieveAll();
+        }
+        if(!more)streamBuff_.Append("0\r\n\r\n", 5);
+    }
+    if(!more){
+        seg.eof = true;
+        seg.producer.reset();
+    }
+    seg.len = streamBuff_.ReadableBytes();
+    toWriteBytes_ += seg.len;
+}
+
+//把响应正文文件中[offset, offset+len)排队
+void HttpConn::PushFile_(off_t offset, size_t len){
+    if(len == 0 || (!response_.File() && response_.FileFd() < 0))return;
+    OutSeg seg;
+    seg.type = response_.File() ? OutSeg::MEM : OutSeg::FILE;
+    seg.data = response_.File() ? response_.File() + offset : nullptr;
+    seg.len = len;
+    seg.offset = offset;
+    seg.fd = response_.FileFd();
+    seg.file = response_.FileHolder();
+    seg.blob = response_.BodyBlob();
+    PushSeg_(std::move(seg));
+}
+
+//把writeBuff_中新追加、还没排队的字节作为一个BUFF段排队
+void HttpConn::PushBuff_(){
+    size_t len = writeBuff_.ReadableBytes() - buffQueued_;
+    if(len == 0)return;
+    buffQueued_ += len;
+    if(!out_.empty() && out_.back().type == OutSeg::BUFF){
+        //和前一个响应头相邻，合并成一段
+        out_.back().len += len;
+        toWriteBytes_ += len;
+        return;
+    }
+    OutSeg seg;
+    seg.type = OutSeg::BUFF;
+    seg.data = nullptr;
+    seg.len = len;
+    seg.offset = 0;
+    seg.fd = -1;
+    PushSeg_(std::move(seg));
+}
+
+void HttpConn::PushSeg_(OutSeg&& seg){
+    toWriteBytes_ += seg.len;
+    out_.push_back(std::move(seg));
 }
 
+//把刚生成的小文件响应(writeBuff_中从start开始的部分 + 文件内容)拷贝成一份只读缓存
+void HttpConn::CacheResponse_(size_t start){
+    ResponseCache* cache = ResponseCache::Instance();
+    const FilePtr& file = response_.FileHolder();
+    size_t fileLen = response_.FileLen();
+    if(!cache->IsOpen() || !file || response_.Producer() || fileLen > cache->MaxFileSize())return;
+    if(fileLen > 0 && !response_.File() && response_.FileFd() < 0)return;
+
+    size_t headLen = writeBuff_.ReadableBytes() - start;
+    std::shared_ptr<std::string> blob = std::make_shared<std::string>();
+    blob->reserve(headLen + fileLen);
+    blob->append(writeBuff_.Peek() + start, headLen);
+    if(response_.File()){
+        blob->append(response_.File(), fileLen);
+    }else if(fileLen > 0){
+        blob->resize(headLen + fileLen);
+        ssize_t n = pread(response_.FileFd(), &(*blob)[headLen], fileLen, 0);
+        if(n != static_cast<ssize_t>(fileLen))return;
+    }
+    cache->Put(request_.path(), isKeepAlive_, encodings_, response_.BodyPath(), file, blob);
+}
@@ -3,19 +3,37 @@
 
 #include<sys/types.h>
 #include<sys/uio.h>
+#include<sys/sendfile.h>
+#include<sys/socket.h>
+#include<fcntl.h>
 #include<arpa/inet.h>
 #include<stdlib.h>
 #include<errno.h>
+#include<deque>
+#include<functional>
 
 #include"../log/log.h"
 #include"../buffer/buffer.h"
 #include"httprequest.h"
 #include"httpresponse.h"
+#include"responsecache.h"
+#include"../timer/timingwheel.h"
+#include"../pool/dbexecutor.h"
+#include"registerwriter.h"
 
 
 //进行读写数据并调用httprequest 来解析数据以及httpresponse来生成响应
 class HttpConn{
 public:
+    //连接所处阶段对应的超时类型
+    enum TIMER_KIND{
+        IDLE_TIMER,     //keep-alive空闲，等下一个请求
+        HEADER_TIMER,   //请求行和头部收了一部分，从开始收算起，不随读事件顺延
+        BODY_TIMER,     //正文收了一部分，每次读事件顺延
+        WRITE_TIMER,    //响应没发完，每次可写事件顺延
+        TIMER_KIND_NUM,
+    };
+
     HttpConn();
     ~HttpConn();
 
@@ -29,28 +47,103 @@ public:
     sockaddr_in GetAddr()const;
     bool process();
 
-    int ToWriteBytes(){
-        return iov_[0].iov_len + iov_[1].iov_len;
+    size_t ToWriteBytes()const{
+        return toWriteBytes_;
+    }
+
+    bool HasBufferedData()const{//读缓冲区里还有没处理的(流水线)请求数据，或者有等待查询的请求
+        return readBuff_.ReadableBytes() > 0 || request_.VerifyState() != HttpRequest::VERIFY_NONE;
+    }
+
+    //process()停在了需要查数据库的请求上：调用方用StartVerify提交查询，done在数据库线程上回调，
+    //调用方回到连接所在的线程后调用FinishVerify生成响应。查询期间process()不做任何处理
+    bool NeedVerify()const{
+        return verify_ == VERIFY_READY;
+    }
+    bool StartVerify(std::function<void(bool)> done);  //排队失败返回false，此时done不会被调用
+    bool FinishVerify(bool ok);                        //返回值同process()
+
+    bool IsClosed()const{
+        return isClose_;
     }
 
     bool IsKeepAlive()const{
-        return request_.IsKeepAlive();
+        return isKeepAlive_;
     }
 
+    TimerNode* Timer(){//嵌在连接里的超时定时器节点，data指向本连接，kind为当前的TIMER_KIND
+        return &timer_;
+    }
+    TIMER_KIND TimerKind()const;
+
+    static int timeoutMs[TIMER_KIND_NUM];
+
     static bool isET;
     static const char* srcDir;
     static std::atomic<int>userCount;
 
 private:
+    //待发送的一段数据，多个(流水线)响应按顺序排在out_里，一次writev尽量多发
+    struct OutSeg{
+        enum TYPE{
+            BUFF,   //writeBuff_里接下来的len个字节(响应头等)
+            MEM,    //外部只读内存：mmap映射或缓存的完整响应
+            FILE,   //用sendfile/splice从fd发送
+            STREAM, //流式正文，数据在streamBuff_里，发完一段再向producer拉下一段
+        };
+        TYPE type;
+        const char* data;
+        size_t len;         //还没发到socket的字节数
+        off_t offset;       //FILE：下一次从文件读取的位置
+        int fd;
+        FilePtr file;       //发送期间持有映射/fd
+        ResponseBlob blob;  //发送期间持有缓存的响应
+        ProducerPtr producer;
+        bool chunked;       //STREAM：是否按chunked编码分块
+        bool eof;           //STREAM：producer已经结束，streamBuff_里是最后的数据
+    };
+
+    enum VERIFY_STATE{
+        VERIFY_IDLE,
+        VERIFY_READY,   //等调用方提交查询
+        VERIFY_RUNNING, //查询中
+    };
+
+    void AddResponse_(bool parsed);
+    void CacheResponse_(size_t start);
+    void PushBuff_();
+    void PushFile_(off_t offset, size_t len);
+    void PushSeg_(OutSeg&& seg);
+    void Consume_(size_t len);
+    void FillStream_(OutSeg& seg);
+    ssize_t WriteIov_();
+    ssize_t WriteFile_();
+    ssize_t SpliceFile_();
+    void ClosePipe_();
+    void ReleaseBuffers_();
+
     int fd_;
     struct sockaddr_in addr_;
     bool isClose_;
-    int iovCnt_;
-    struct iovec iov_[2];
-    Buffer readBuff_;
+    bool isKeepAlive_;      //最近一个响应是否保持连接，为false时写完就关闭
+    int encodings_;         //当前请求可接受的编码，见HttpResponse::AcceptEncodings
+    VERIFY_STATE verify_;
+    std::deque<OutSeg> out_;
+    size_t toWriteBytes_;
+    size_t buffQueued_;     //writeBuff_中已经排进out_的字节数
+    int pipeFd_[2];         //splice用的管道，按需创建
+    size_t pipeBytes_;      //已经进入管道但还没写到socket的字节数(属于out_队首的FILE段)
+    bool useSplice_;
+    ChainBuffer readBuff_;  //定长块串起来，大请求体不会引起realloc和搬移
     Buffer writeBuff_;
+    Buffer streamBuff_;     //当前流式响应的一段正文(含chunk头尾)，同一时刻最多一个STREAM段
     HttpRequest request_;
     HttpResponse response_;
+    TimerNode timer_;
+
+    static const int MAX_PIPELINE = 32;     //一次process最多处理的流水线请求数
+    static const int MAX_IOV = 64;
+    static const size_t STREAM_CHUNK = 16 * 1024;   //每次向producer拉取的正文大小
 };
 
 #endif
\ No newline at end of file
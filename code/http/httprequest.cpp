@@ -9,57 +9,207 @@ const unordered_map<string, int>HttpRequest::DEFAULT_HTML_TAG{
     {"/register.html", 0}, {"/login.html", 1}
 };
 
+size_t HttpRequest::maxBodySize = 1024 * 1024;
+size_t HttpRequest::spillSize = 0;
+const char* HttpRequest::spillDir = "/tmp";
+
+HttpRequest::~HttpRequest(){
+    if(bodyFd_ >= 0)close(bodyFd_);
+}
+
 void HttpRequest::Init(){
-    method_ = path_ = version_ = body_ = "";
-    state_ = REQUEST_LINE;
+    //clear()保留容量，连接上的后续请求复用这些内存
+    method_.clear();
+    path_.clear();
+    version_.clear();
+    body_.clear();
+    headerData_.clear();
     header_.clear();
+    state_ = REQUEST_LINE;
+    scanned_ = 0;
+    headerBytes_ = 0;
+    contentLength_ = 0;
+    hasContentLength_ = false;
+    chunked_ = false;
+    expectContinue_ = false;
+    errCode_ = 400;
+    bodyRemain_ = 0;
+    bodyLen_ = 0;
+    if(bodyFd_ >= 0){
+        close(bodyFd_);
+        bodyFd_ = -1;
+    }
     post_.clear();
+    verify_ = VERIFY_NONE;
+}
+
+//头部收完且StartBody_接受了正文之后才让客户端发送，413/501和没有正文的请求都不回100
+bool HttpRequest::ExpectContinue(){
+    if(!expectContinue_ || bodyLen_ != 0)return false;
+    if(state_ != BODY && state_ != CHUNK_SIZE && state_ != CHUNK_DATA)return false;
+    expectContinue_ = false;
+    return true;
 }
 
 bool HttpRequest::IsKeepAlive()const{
-    if(header_.count("Connection")){
-        return header_.find("Connection")->second == "keep-alive" && version_ == "1.1";
+    return Header("Connection").EqualsIgnoreCase("keep-alive") && version_ == "1.1";
+}
+
+StrSpan HttpRequest::Header(const char* key)const{
+    size_t keyLen = strlen(key);
+    for(const HeaderField& field: header_){
+        if(field.keyLen == keyLen && strncasecmp(headerData_.data() + field.keyOff, key, keyLen) == 0){
+            return StrSpan(headerData_.data() + field.valOff, field.valLen);
+        }
     }
-    return false;
+    return StrSpan();
 }
 
-bool HttpRequest::parse(Buffer& buff){
-    const char CRLF[] = "\r\n";
-    if(buff.ReadableBytes() <= 0){
-        return false;
+//增量解析：只消费完整的行，不完整的行留在buff里，下一次读到数据后从scanned_处继续；
+//正文边到边消费，按块直接取片段，不需要整个正文都在buff里，也不需要连续
+HttpRequest::PARSE_RESULT HttpRequest::parse(ChainBuffer& buff){
+    if(state_ == FINISH){
+        Init();
     }
-    while(buff.ReadableBytes() && state_ != FINISH){
-        //查找 可读 范围内第一个 crlf的 子序列， 返回的是crlf的位置
-        const char* lineEnd = search(buff.Peek(), buff.BeginWriteConst(),CRLF, CRLF + 2);
-        std::string line(buff.Peek(), lineEnd);
+    while(state_ != FINISH){
+        if(state_ == BODY || state_ == CHUNK_DATA){
+            size_t len = buff.PeekBytes() < bodyRemain_ ? buff.PeekBytes() : bodyRemain_;
+            if(len == 0){
+                return PARSE_AGAIN;
+            }
+            if(!AppendBody_(buff.Peek(), len)){
+                return PARSE_ERROR;
+            }
+            buff.Retrieve(len);
+            bodyRemain_ -= len;
+            if(bodyRemain_ > 0){
+                continue;//下一个块里可能还有正文
+            }
+            if(state_ == BODY){
+                FinishBody_();
+            }else{
+                state_ = CHUNK_CRLF;
+            }
+            continue;
+        }
+        const char* begin = buff.Peek();
+        const char* end = begin + buff.PeekBytes();
+        const char* lineEnd = Scanner::FindChar(begin + scanned_, end, '\n');
+        //块大小行和块后的换行是正文的分帧，单独用小得多的行长限制，不计入头部大小
+        bool framing = state_ == CHUNK_SIZE || state_ == CHUNK_CRLF;
+        size_t maxLine = framing ? MAX_CHUNK_LINE : MAX_LINE;
+        if(lineEnd == end){
+            scanned_ = end - begin;
+            if(scanned_ > maxLine){
+                LOG_WARN("Request line too long");
+                return PARSE_ERROR;
+            }
+            if(buff.ReadableBytes() > scanned_){
+                //行跨了块，把后面的数据拼到第一个块里接着找，最多拼到maxLine+1
+                size_t want = buff.ReadableBytes() < maxLine + 1 ? buff.ReadableBytes() : maxLine + 1;
+                buff.MakeContiguous(want);
+                continue;
+            }
+            return PARSE_AGAIN;
+        }
+        const char* next = lineEnd + 1;
+        if(lineEnd > begin && lineEnd[-1] == '\r'){
+            lineEnd--;
+        }
+        scanned_ = 0;
+        if(framing){
+            if((size_t)(next - begin) > MAX_CHUNK_LINE){
+                LOG_WARN("Chunk size line too long");
+                return PARSE_ERROR;
+            }
+        }else{
+            headerBytes_ += next - begin;
+            if(headerBytes_ > MAX_HEADER){
+                LOG_WARN("Request header too large");
+                return PARSE_ERROR;
+            }
+        }
         switch (state_)
         {
         case REQUEST_LINE:
-            if(!ParseRequestLine_(line)){
-                return false;
+            if(begin == lineEnd){
+                break;//请求之前多余的空行直接忽略
+            }
+            if(!ParseRequestLine_(begin, lineEnd) || !parsePath_()){
+                return PARSE_ERROR;
             }
-            parsePath_();
             break;
         case HEADERS:
-            ParseHeader_(line);
-            if(buff.ReadableBytes() <= 2){
-                state_ = FINISH;
+            if(begin == lineEnd){//空行，头部结束
+                if(!StartBody_()){
+                    return PARSE_ERROR;
+                }
+            }else if(!ParseHeader_(begin, lineEnd)){
+                return PARSE_ERROR;
+            }
+            break;
+        case CHUNK_SIZE:
+            if(!ParseChunkSize_(begin, lineEnd)){
+                return PARSE_ERROR;
+            }
+            break;
+        case CHUNK_CRLF:
+            if(begin != lineEnd){//块数据后面必须紧跟换行
+                LOG_ERROR("Chunk data error");
+                return PARSE_ERROR;
             }
+            state_ = CHUNK_SIZE;
             break;
-        case BODY:
-            parseBody_(line);
+        case TRAILERS:
+            if(begin == lineEnd){//trailer不使用，只跳过
+                FinishBody_();
+            }
             break;
         default:
             break;
         }
-        if(lineEnd == buff.BeginWrite()){break;}
-        buff.RetrieveUntil(lineEnd + 2);
+        buff.Retrieve(next - begin);
     }
     LOG_DEBUG("[%s], [%s], [%s]", method_.c_str(),path_.c_str(), version_.c_str());
-    return true;
+    return PARSE_OK;
 }
 
-void HttpRequest::parsePath_(){
+//去掉查询串并做百分号解码，含..段(可能逃出资源目录)、%00或不以/开头的路径都拒绝
+bool HttpRequest::parsePath_(){
+    size_t query = path_.find('?');
+    if(query != string::npos){
+        path_.resize(query);
+    }
+    if(path_.empty() || path_[0] != '/'){
+        LOG_ERROR("Path error: %s", path_.c_str());
+        return false;
+    }
+    size_t n = 0;
+    for(size_t i = 0; i < path_.size(); i++){
+        char ch = path_[i];
+        if(ch == '%'){
+            int hi = i + 2 < path_.size() ? HexValue_(path_[i + 1]) : -1;
+            int lo = hi >= 0 ? HexValue_(path_[i + 2]) : -1;
+            if(lo < 0 || (hi == 0 && lo == 0)){
+                LOG_ERROR("Path escape error");
+                return false;
+            }
+            ch = (char)(hi * 16 + lo);
+            i += 2;
+        }
+        path_[n++] = ch;
+    }
+    path_.resize(n);
+    for(size_t pos = 0; pos < path_.size(); ){
+        size_t next = path_.find('/', pos + 1);
+        if(next == string::npos)next = path_.size();
+        if(next - pos == 3 && path_.compare(pos, 3, "/..") == 0){
+            LOG_ERROR("Path traversal: %s", path_.c_str());
+            return false;
+        }
+        pos = next;
+    }
+
     if(path_ == "/"){
         path_ = "/index.html";
     }else{
@@ -70,41 +220,201 @@ void HttpRequest::parsePath_(){
             }
         }
     }
+    return true;
 }
 
-bool HttpRequest::ParseRequestLine_(const string& line){
+bool HttpRequest::ParseRequestLine_(const char* begin, const char* end){
     //http请求行格式为：<Method> <Path> HTTP/<Version>
-    regex pattern("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-    smatch subMatch;
-    if(regex_match(line, subMatch, pattern)){
-        method_ = subMatch[1];
-        path_ = subMatch[2];
-        version_ = subMatch[3];
-        state_ = HEADERS;
+    const char* sp1 = Scanner::FindChar(begin, end, ' ');
+    const char* sp2 = sp1 == end ? end : Scanner::FindChar(sp1 + 1, end, ' ');
+    const char* ver = sp2 + 1;
+    if(sp1 == begin || sp2 == end || sp2 == sp1 + 1 ||
+       end - ver <= 5 || memcmp(ver, "HTTP/", 5) != 0 ||
+       Scanner::FindChar(ver, end, ' ') != end){
+        LOG_ERROR("RequestLine Error");
+        return false;
+    }
+    method_.assign(begin, sp1);
+    path_.assign(sp1 + 1, sp2);
+    version_.assign(ver + 5, end);
+    state_ = HEADERS;
+    return true;
+}
+
+bool HttpRequest::ParseHeader_(const char* begin, const char* end){
+    //如：Content-Type: text/html，键为冒号前的部分，值去掉首尾空白
+    const char* colon = Scanner::FindChar(begin, end, ':');
+    if(colon == end || colon == begin){
+        LOG_ERROR("Header Error");
+        return false;
+    }
+    const char* val = colon + 1;
+    while(val < end && (*val == ' ' || *val == '\t'))val++;
+    const char* valEnd = end;
+    while(valEnd > val && (valEnd[-1] == ' ' || valEnd[-1] == '\t'))valEnd--;
+
+    HeaderField field;
+    field.keyOff = headerData_.size();
+    field.keyLen = colon - begin;
+    headerData_.append(begin, colon);
+    field.valOff = headerData_.size();
+    field.valLen = valEnd - val;
+    headerData_.append(val, valEnd);
+    header_.push_back(field);
+
+    if(field.keyLen == 14 && strncasecmp(begin, "Content-Length", 14) == 0){
+        if(val == valEnd)return false;
+        size_t len = 0;
+        for(const char* p = val; p < valEnd; p++){
+            if(*p < '0' || *p > '9' || len > (SIZE_MAX - 9) / 10)return false;
+            len = len * 10 + (*p - '0');
+        }
+        if(hasContentLength_ && len != contentLength_){
+            LOG_ERROR("Conflicting Content-Length");
+            return false;
+        }
+        hasContentLength_ = true;
+        contentLength_ = len;
+    }else if(field.keyLen == 17 && strncasecmp(begin, "Transfer-Encoding", 17) == 0){
+        //只支持以chunked结尾的编码，其他编码无法确定正文边界
+        StrSpan value(val, valEnd - val);
+        if(value.len < 7 || strncasecmp(valEnd - 7, "chunked", 7) != 0){
+            LOG_ERROR("Unsupported Transfer-Encoding");
+            errCode_ = 501;
+            return false;
+        }
+        chunked_ = true;
+    }else if(field.keyLen == 6 && strncasecmp(begin, "Expect", 6) == 0){
+        expectContinue_ = StrSpan(val, valEnd - val).EqualsIgnoreCase("100-continue");
+    }
+    return true;
+}
+
+//头部结束，根据Transfer-Encoding/Content-Length决定正文怎么读
+bool HttpRequest::StartBody_(){
+    headerBytes_ = 0;//之后只有chunked的trailer还计入头部大小
+    if(chunked_){
+        //同时出现时以chunked为准，忽略Content-Length
+        state_ = CHUNK_SIZE;
+        return true;
+    }
+    if(contentLength_ == 0){
+        FinishBody_();
         return true;
     }
-    LOG_ERROR("RequestLine Error");
-    return false;
+    if(maxBodySize > 0 && contentLength_ > maxBodySize){
+        LOG_WARN("Body too large: %llu", (unsigned long long)contentLength_);
+        errCode_ = 413;
+        return false;
+    }
+    if(spillSize > 0 && contentLength_ > spillSize){
+        //已知会超过阈值，直接写临时文件，不在内存里攒
+        if(!OpenSpill_())return false;
+    }else if(maxBodySize > 0){
+        body_.reserve(contentLength_);
+    }
+    bodyRemain_ = contentLength_;
+    state_ = BODY;
+    return true;
 }
 
-void HttpRequest::ParseHeader_(const string& line){
-    //如：Content-Type: text/html
-    //subMatch[1] 是 "Content-Type"。
-    //subMatch[2] 是 " text/html"
-    regex patten("^([^:]*): ?(.*)$");
-    smatch subMatch;
-    if(regex_match(line, subMatch, patten)){
-        header_[subMatch[1]] = subMatch[2];
-    }else{
-        state_ = BODY;
+//块大小行：十六进制大小，后面可以跟;扩展
+bool HttpRequest::ParseChunkSize_(const char* begin, const char* end){
+    size_t size = 0;
+    const char* p = begin;
+    for(; p < end; p++){
+        int digit;
+        if(*p >= '0' && *p <= '9')digit = *p - '0';
+        else if(*p >= 'a' && *p <= 'f')digit = *p - 'a' + 10;
+        else if(*p >= 'A' && *p <= 'F')digit = *p - 'A' + 10;
+        else break;
+        if(size > (SIZE_MAX >> 4)){
+            LOG_ERROR("Chunk size overflow");
+            return false;
+        }
+        size = (size << 4) | digit;
+    }
+    if(p == begin || (p < end && *p != ';' && *p != ' ' && *p != '\t')){
+        LOG_ERROR("Chunk size error");
+        return false;
     }
+    if(size == 0){
+        state_ = TRAILERS;
+        return true;
+    }
+    if(maxBodySize > 0 && (size > maxBodySize || bodyLen_ + size > maxBodySize)){
+        LOG_WARN("Chunked body too large");
+        errCode_ = 413;
+        return false;
+    }
+    bodyRemain_ = size;
+    state_ = CHUNK_DATA;
+    return true;
 }
 
-void HttpRequest::parseBody_(const string& line){
-    body_ = line;
-    ParsePost_();
+bool HttpRequest::AppendBody_(const char* data, size_t len){
+    if(bodyFd_ < 0 && spillSize > 0 && body_.size() + len > spillSize){
+        //chunked正文事先不知道长度，超过阈值时把已收到的部分一起转存
+        if(!OpenSpill_())return false;
+        if(!AppendBody_(body_.data(), body_.size()))return false;
+        bodyLen_ -= body_.size();
+        body_.clear();
+    }
+    if(bodyFd_ >= 0){
+        while(len > 0){
+            ssize_t n = ::write(bodyFd_, data, len);
+            if(n < 0 && errno == EINTR)continue;
+            if(n <= 0){
+                LOG_ERROR("Write body file error: %s", strerror(errno));
+                errCode_ = 500;
+                return false;
+            }
+            data += n;
+            len -= n;
+            bodyLen_ += n;
+        }
+        return true;
+    }
+    body_.append(data, len);
+    bodyLen_ += len;
+    return true;
+}
+
+//临时文件创建后立即不可见(O_TMPFILE或unlink)，连接关闭时close即释放磁盘
+bool HttpRequest::OpenSpill_(){
+#ifdef O_TMPFILE
+    bodyFd_ = open(spillDir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+#endif
+    if(bodyFd_ < 0){
+        string name = string(spillDir) + "/webserver-body-XXXXXX";
+        bodyFd_ = mkostemp(&name[0], O_CLOEXEC);
+        if(bodyFd_ >= 0)unlink(name.c_str());
+    }
+    if(bodyFd_ < 0){
+        LOG_ERROR("Create body file in %s error: %s", spillDir, strerror(errno));
+        errCode_ = 500;
+        return false;
+    }
+    return true;
+}
+
+void HttpRequest::FinishBody_(){
     state_ = FINISH;
-    LOG_DEBUG("Body:%s, len:%d", line.c_str(), line.size());
+    if(bodyLen_ == 0)return;
+    if(bodyFd_ >= 0){
+        //转存到文件的正文不做表单解析，由使用方从BodyFd读取
+        LOG_DEBUG("Body len:%d, in file", (int)bodyLen_);
+        return;
+    }
+    ParsePost_();
+    LOG_DEBUG("Body len:%d", (int)bodyLen_);
+}
+
+int HttpRequest::HexValue_(char ch){
+    if(ch >= '0' && ch <= '9')return ch - '0';
+    if(ch >= 'A' && ch <= 'F')return ch - 'A' + 10;
+    if(ch >= 'a' && ch <= 'f')return ch - 'a' + 10;
+    return -1;
 }
 
 int HttpRequest::ConvertHex(char ch){
@@ -115,24 +425,33 @@ int HttpRequest::ConvertHex(char ch){
 
 void HttpRequest::ParsePost_(){
     //Content-Type: application/x-www-form-urlencoded,表示请求体中的数据是以 URL 编码的键值对形式提交的
-    if(method_ == "POST" && header_["Content-Type"]== "application/x-www-form-urlencoded"){
+    if(method_ == "POST" && Header("Content-Type").StartsWithIgnoreCase("application/x-www-form-urlencoded")){
         ParseFromUrlEncoded_();
         if(DEFAULT_HTML_TAG.count(path_)){
             // unordered_map 是 const的，必须使用 find 方法，因为 operator[] 不能用于 const 容器
             int tag = DEFAULT_HTML_TAG.find(path_)->second;
             LOG_DEBUG("Tag:%d",tag);
             if(tag == 0 || tag == 1){//tag = 1表示登陆，为0表示注册
-                bool isLogin = (tag == 1);
-                if(UserVerify(post_["username"], post_["password"], isLogin)){
-                    path_ = "/welcome.html";
-                }else{
+                auth_.name = post_["username"];
+                auth_.pwd = post_["password"];
+                auth_.isLogin = (tag == 1);
+                if(auth_.name.empty() || auth_.pwd.empty()){
+                    //不用查数据库就知道结果
                     path_ = "/error.html";
+                }else{
+                    verify_ = VERIFY_PENDING;
                 }
             }
         }
     }
 }
 
+void HttpRequest::FinishVerify(bool ok){
+    assert(verify_ == VERIFY_PENDING);
+    path_ = ok ? "/welcome.html" : "/error.html";
+    verify_ = VERIFY_DONE;
+}
+
 void HttpRequest::ParseFromUrlEncoded_(){
     if(body_.size() == 0){return ;}
     string key,value;
@@ -177,66 +496,127 @@ void HttpRequest::ParseFromUrlEncoded_(){
     }
 }
 
+//登录/注册：先查凭据缓存，未命中再用预处理语句查数据库，参数走绑定不再拼接sql
 bool HttpRequest::UserVerify(const string& name, const string &pwd, bool isLogin){
-    
     if(name == "" || pwd == "")return false;
-    LOG_INFO("Verify name:%s, pwd:%s", name.c_str(),pwd.c_str());
-    MYSQL* sql;
-    SqlConnRAII(&sql, SqlConnPool::Instance());
-    assert(sql);
+    LOG_INFO("Verify name:%s", name.c_str());
 
-    bool flag = false;//标志能否注册
-    unsigned int j = 0;
-    char order[256] = {0};
-    MYSQL_FIELD* fields = nullptr;//存储查询结果
-    MYSQL_RES* res = nullptr;//存储查询结构集
+    AuthCache::RESULT cached = AuthCache::Instance()->Lookup(name, pwd);
+    if(isLogin && cached != AuthCache::MISS){
+        LOG_DEBUG("Verify %s from cache: %d", name.c_str(), (int)cached);
+        return cached == AuthCache::MATCH;
+    }
+    if(!isLogin && (cached == AuthCache::MATCH || cached == AuthCache::MISMATCH)){
+        LOG_INFO("user used!");
+        return false;
+    }
 
-    if(!isLogin)flag = true;
+    MYSQL* sql;
+    SqlConnRAII sqlRAII(&sql, SqlConnPool::Instance());
+    if(!sql)return false;
 
-    snprintf(order, 256, "SELECT username, password From user WHERE username='%s' LIMIT1",name.c_str());
-    LOG_DEBUG("%s",order);
+    string password;
+    int found = QueryPassword_(sql, name, &password);
+    if(found < 0)return false;
+    if(isLogin){
+        if(found == 0){
+            AuthCache::Instance()->PutNoUser(name);
+            return false;
+        }
+        AuthCache::Instance()->Put(name, password);
+        if(pwd != password){
+            LOG_INFO("pwd error!");
+            return false;
+        }
+        return true;
+    }
+    if(found == 1){//注册，但是重名了
+        AuthCache::Instance()->Put(name, password);
+        LOG_INFO("user used!");
+        return false;
+    }
 
-    if(mysql_query(sql,order)){//执行成功返回0
-        mysql_free_result(res);
+    LOG_DEBUG("register!");
+    if(!InsertUser_(sql, name, pwd)){
+        LOG_DEBUG("Insert error!");
         return false;
     }
+    //之前缓存的查无此人作废
+    AuthCache::Instance()->Invalidate(name);
+    LOG_DEBUG("UserVerify success!");
+    return true;
+}
 
-    res = mysql_store_result(sql);//查询结果集
-    j = mysql_num_fields(res);//列数，2, username 和 password
-    fields = mysql_fetch_field(res);//字段信息,
+//查询name的密码，找到返回1，没有这个用户返回0，出错返回-1
+int HttpRequest::QueryPassword_(MYSQL* sql, const string& name, string* password){
+    MYSQL_STMT* stmt = SqlConnPool::Instance()->GetStmt(sql,
+        "SELECT password FROM user WHERE username = ? LIMIT 1");
+    if(!stmt)return -1;
 
-    while(MYSQL_ROW row = mysql_fetch_row(res)){
-        LOG_DEBUG("MYSQL ROW: %s %s",row[0], row[1]);
-        string password(row[1]);
+    MYSQL_BIND param;
+    memset(&param, 0, sizeof(param));
+    unsigned long nameLen = name.size();
+    param.buffer_type = MYSQL_TYPE_STRING;
+    param.buffer = (void*)name.data();
+    param.buffer_length = nameLen;
+    param.length = &nameLen;
 
-        if(isLogin){//登陆
-            if(pwd == password)flag = true;
-            else {
-                flag = false;
-                LOG_INFO("pwd error!");
-            }
-        }else{//注册， 但是重名了
-            flag = false;
-            LOG_INFO("user used!");
-        }
+    char pwdBuf[256];
+    unsigned long pwdLen = 0;
+    //MySQL 8为bool，更早的版本和MariaDB为my_bool
+    std::remove_pointer<decltype(MYSQL_BIND::is_null)>::type isNull = 0;
+    MYSQL_BIND result;
+    memset(&result, 0, sizeof(result));
+    result.buffer_type = MYSQL_TYPE_STRING;
+    result.buffer = pwdBuf;
+    result.buffer_length = sizeof(pwdBuf);
+    result.length = &pwdLen;
+    result.is_null = &isNull;
+
+    if(mysql_stmt_bind_param(stmt, &param) || mysql_stmt_bind_result(stmt, &result) ||
+        mysql_stmt_execute(stmt)){
+        LOG_ERROR("Mysql query user error: %s", mysql_stmt_error(stmt));
+        SqlConnPool::Instance()->ResetStmts(sql);
+        return -1;
+    }
+    //不用mysql_stmt_store_result把结果集整个拉到客户端，LIMIT 1最多一行，直接取
+    int ret = mysql_stmt_fetch(stmt);
+    int found = -1;
+    if(ret == 0 && !isNull){
+        password->assign(pwdBuf, pwdLen);
+        found = 1;
+    }else if(ret == MYSQL_NO_DATA){
+        found = 0;
+    }else{
+        LOG_ERROR("Mysql fetch user error: %d", ret);
     }
+    mysql_stmt_free_result(stmt);
+    return found;
+}
 
-    mysql_free_result(res);
-    //注册， 且没有重名
-    if(!isLogin && flag == true){
-        LOG_DEBUG("register!");
-        bzero(order, 256);
-        snprintf(order, 256, "INSERT INTO user(username, password) VALUES('%s','%s')", name.c_str(), pwd.c_str());
-        LOG_DEBUG("%s", order);
-        if(mysql_query(sql,order)){
-            LOG_DEBUG("Insert error!");
-            flag = false;
-        }
-        flag = true;
+bool HttpRequest::InsertUser_(MYSQL* sql, const string& name, const string& pwd){
+    MYSQL_STMT* stmt = SqlConnPool::Instance()->GetStmt(sql,
+        "INSERT INTO user(username, password) VALUES(?, ?)");
+    if(!stmt)return false;
+
+    MYSQL_BIND params[2];
+    memset(params, 0, sizeof(params));
+    unsigned long lens[2] = {name.size(), pwd.size()};
+    params[0].buffer_type = MYSQL_TYPE_STRING;
+    params[0].buffer = (void*)name.data();
+    params[0].buffer_length = lens[0];
+    params[0].length = &lens[0];
+    params[1].buffer_type = MYSQL_TYPE_STRING;
+    params[1].buffer = (void*)pwd.data();
+    params[1].buffer_length = lens[1];
+    params[1].length = &lens[1];
+
+    if(mysql_stmt_bind_param(stmt, params) || mysql_stmt_execute(stmt)){
+        LOG_ERROR("Mysql insert user error: %s", mysql_stmt_error(stmt));
+        SqlConnPool::Instance()->ResetStmts(sql);
+        return false;
     }
-    SqlConnPool::Instance()->FreeConn(sql);
-    LOG_DEBUG("UserVerify success!");
-    return flag;
+    return true;
 }
 
 std::string HttpRequest::path()const{
@@ -4,28 +4,59 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <string>
-#include <regex>
+#include <vector>
+#include <type_traits>
 #include <errno.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <mysql/mysql.h>
 
 #include "../buffer/buffer.h"
+#include "../buffer/chainbuffer.h"
 #include "../log/log.h"
 #include "../pool/sqlconnpool.h"
+#include "scanner.h"
+#include "authcache.h"
 
 class HttpRequest{
 public:
     enum PARSE_STATE{
         REQUEST_LINE,
         HEADERS,
-        BODY,
+        BODY,           //按Content-Length读取正文
+        CHUNK_SIZE,     //chunked：块大小行
+        CHUNK_DATA,     //chunked：块数据
+        CHUNK_CRLF,     //chunked：块数据后的换行
+        TRAILERS,       //chunked：结尾的trailer头部
         FINISH,
     };
 
-    HttpRequest(){Init();}
-    ~HttpRequest()=default;
+    enum PARSE_RESULT{
+        PARSE_AGAIN,    //请求还不完整，等待更多数据
+        PARSE_OK,       //解析出一个完整请求
+        PARSE_ERROR,    //请求格式错误
+    };
+
+    //登录、注册表单需要查数据库：解析时只记录下来，由HttpConn交给DbExecutor，查完再生成响应
+    enum VERIFY_STATE{
+        VERIFY_NONE,
+        VERIFY_PENDING, //等待查询
+        VERIFY_DONE,    //已经有结果，path()指向结果页面
+    };
+
+    struct UserAuth{
+        std::string name;
+        std::string pwd;
+        bool isLogin;
+    };
+
+    HttpRequest():bodyFd_(-1){Init();}
+    ~HttpRequest();
 
     void Init();
-    bool parse(Buffer& buff);
+    PARSE_RESULT parse(ChainBuffer& buff);
+    PARSE_STATE State() const { return state_; }
 
     std::string path() const;
     std::string& path();
@@ -33,28 +64,74 @@ public:
     std::string version() const;
     std::string GetPost(const std::string& key) const;
     std::string GetPost(const char* key) const;
+    StrSpan Header(const char* key) const;   //不区分大小写，返回的片段在下一次Init前有效
 
     bool IsKeepAlive() const;
+    int ErrorCode() const { return errCode_; }  //PARSE_ERROR时对应的响应状态码
+    bool ExpectContinue();                      //头部带Expect: 100-continue，正文已被接受且还没收到，只返回一次true
+
+    VERIFY_STATE VerifyState() const { return verify_; }
+    const UserAuth& Auth() const { return auth_; }
+    void FinishVerify(bool ok);
+    //阻塞的数据库查询，在DbExecutor线程上执行
+    static bool UserVerify(const std::string&name, const std::string& pwd, bool isLogin);
+
+    //正文：未超过spillSize时在Body()里，否则写入已删除的临时文件BodyFd()
+    const std::string& Body() const { return body_; }
+    int BodyFd() const { return bodyFd_; }
+    size_t BodyLength() const { return bodyLen_; }
+
+    static size_t maxBodySize;      //正文上限，超过返回413，0为不限制
+    static size_t spillSize;        //正文超过该大小时转存到临时文件，0为不转存
+    static const char* spillDir;
 
 private:
-    bool ParseRequestLine_(const std::string& line);
-    void ParseHeader_(const std::string& line);
-    void parseBody_(const std::string& line);
+    bool ParseRequestLine_(const char* begin, const char* end);
+    bool ParseHeader_(const char* begin, const char* end);
+    bool ParseChunkSize_(const char* begin, const char* end);
+    bool StartBody_();
+    bool AppendBody_(const char* data, size_t len);
+    bool OpenSpill_();
+    void FinishBody_();
 
-    void parsePath_();
+    bool parsePath_();
     void ParsePost_();
     void ParseFromUrlEncoded_();
+    static int QueryPassword_(MYSQL* sql, const std::string& name, std::string* password);
+    static bool InsertUser_(MYSQL* sql, const std::string& name, const std::string& pwd);
+
+    //头部字段以偏移量记录在headerData_里，Init只清空不释放，稳定后解析不再分配内存
+    struct HeaderField{
+        size_t keyOff, keyLen;
+        size_t valOff, valLen;
+    };
 
-    static bool UserVerify(const std::string&name, const std::string& pwd, bool isLogin);
-    
     PARSE_STATE state_;
+    size_t scanned_;        //当前未完整的行已经扫描过的字节数，下次从这里接着找换行
+    size_t headerBytes_;    //请求行+头部已用的字节数，正文开始后只计trailer
+    size_t contentLength_;
+    bool hasContentLength_;
+    bool chunked_;
+    bool expectContinue_;
+    int errCode_;
+    size_t bodyRemain_;     //当前Content-Length正文或当前块还没收到的字节数
+    size_t bodyLen_;        //已收到的正文总长度
+    int bodyFd_;            //正文转存的临时文件，没有时为-1
     std::string method_, path_, version_, body_;
-    std::unordered_map<std::string,std::string>header_;
+    std::string headerData_;
+    std::vector<HeaderField>header_;
     std::unordered_map<std::string,std::string>post_;
+    VERIFY_STATE verify_;
+    UserAuth auth_;
+
+    static const size_t MAX_LINE = 8192;            //单行最大长度
+    static const size_t MAX_HEADER = 64 * 1024;     //请求行+头部最大长度
+    static const size_t MAX_CHUNK_LINE = 1024;      //块大小行(含扩展)最大长度
 
     static const std::unordered_set<std::string>DEFAULT_HTML;
     static const std::unordered_map<std::string, int>DEFAULT_HTML_TAG;
     static int ConvertHex(char ch);
+    static int HexValue_(char ch);      //不是十六进制字符返回-1
 };
 
 #endif
\ No newline at end of file
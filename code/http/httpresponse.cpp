@@ -17,6 +17,7 @@ const unordered_map<string,string>HttpResponse::SUFFIX_TYPE ={
     { ".mpeg",  "video/mpeg" },
     { ".mpg",   "video/mpeg" },
     { ".avi",   "video/x-msvideo" },
+    { ".mp4",   "video/mp4" },
     { ".gz",    "application/x-gzip" },
     { ".tar",   "application/x-tar" },
     { ".css",   "text/css "},
@@ -25,9 +26,15 @@ const unordered_map<string,string>HttpResponse::SUFFIX_TYPE ={
 
 const unordered_map<int, string> HttpResponse::CODE_STATUS = {
     { 200, "OK" },
+    { 206, "Partial Content" },
+    { 304, "Not Modified" },
     { 400, "Bad Request" },
     { 403, "Forbidden" },
     { 404, "Not Found" },
+    { 413, "Payload Too Large" },
+    { 416, "Range Not Satisfiable" },
+    { 500, "Internal Server Error" },
+    { 501, "Not Implemented" },
 };
 
 const unordered_map<int, string> HttpResponse::CODE_PATH = {
@@ -36,12 +43,24 @@ const unordered_map<int, string> HttpResponse::CODE_PATH = {
     { 404, "/404.html" },
 };
 
+int HttpResponse::sendMode = HttpResponse::MMAP_WRITEV;
+bool HttpResponse::autoIndex = false;
+bool HttpResponse::gzipStatic = false;
+vector<pair<string, string>> HttpResponse::cacheControl_;
+
 HttpResponse::HttpResponse(){
     code_ = -1;
     path_ = srcDir_ = "";
     isKeepAlive_ = false;
     mmFile_ = nullptr;
+    fileFd_ = -1;
     mmFileStat_ = {0};
+    chunked_ = false;
+    acceptEnc_ = 0;
+    encoding_ = nullptr;
+    compress_ = false;
+    compressPending_ = false;
+    vary_ = false;
 }
 
 HttpResponse::~HttpResponse(){
@@ -50,32 +69,86 @@ HttpResponse::~HttpResponse(){
 
 void HttpResponse::Init(const string& srcDir, string& path, bool isKeepAlive, int code){
     assert(srcDir != "");
-    if(mmFile_){UnmapFile();}
+    UnmapFile();
     code_ = code;
     isKeepAlive_ = isKeepAlive;
     path_ = path;
     srcDir_ = srcDir;
     mmFile_ = nullptr;
     mmFileStat_ = {0};
+    chunked_ = false;
+    range_.clear();
+    ifRange_.clear();
+    ifNoneMatch_.clear();
+    ifModifiedSince_.clear();
+    ranges_.clear();
+    rangeTail_.clear();
+    acceptEnc_ = 0;
+    encoding_ = nullptr;
+    compress_ = false;
+    compressPending_ = false;
+    vary_ = false;
+    bodyPath_.clear();
 }
 
-void HttpResponse::UnmapFile(){
-    if(mmFile_){
-        munmap(mmFile_,mmFileStat_.st_size);
-        mmFile_ = nullptr;
+void HttpResponse::SetRange(const string& range, const string& ifRange){
+    range_ = range;
+    ifRange_ = ifRange;
+}
+
+void HttpResponse::SetConditions(const string& ifNoneMatch, const string& ifModifiedSince){
+    ifNoneMatch_ = ifNoneMatch;
+    ifModifiedSince_ = ifModifiedSince;
+}
+
+void HttpResponse::AddCacheControl(const string& prefix, const string& value){
+    auto it = cacheControl_.begin();
+    while(it != cacheControl_.end() && it->first.size() >= prefix.size()){
+        if(it->first == prefix){
+            it->second = value;
+            return;
+        }
+        ++it;
     }
+    cacheControl_.insert(it, make_pair(prefix, value));
+}
+
+//释放本次响应对文件的引用，fd和映射由FileEntry在最后一个持有者释放时关闭
+void HttpResponse::UnmapFile(){
+    mmFile_ = nullptr;
+    fileFd_ = -1;
+    file_.reset();
+    producer_.reset();
+    compressed_.reset();
 }
 
 void HttpResponse::MakeResponse(Buffer& buff){
     //检查文件是否存在，文件是一个目录
     //srcDir + path就是文件路径,将文件信息存在mmFileStat_里
-    if(stat((srcDir_ + path_).data(), &mmFileStat_ )< 0 || S_ISDIR(mmFileStat_.st_mode)){
+    if(code_ >= 400){
+        //解析阶段已确定的错误(如400)，不再用请求路径覆盖状态码
+    }else if(!StatFile_() || (S_ISDIR(mmFileStat_.st_mode) && !autoIndex)){
         code_ = 404;
     }else if(!(mmFileStat_.st_mode & S_IROTH)){//是否有其他用户的读权限
         code_ = 403;
+    }else if(S_ISDIR(mmFileStat_.st_mode) && !OpenDirList_()){
+        code_ = 403;
     }else if(code_ == -1){
         code_ = 200;
     }
+    if(code_ == 200 && S_ISREG(mmFileStat_.st_mode)){
+        //先定下实际发送的编码(ETag随编码变化)，再判断缓存验证，最后处理Range。
+        //即时压缩只查缓存或交给后台，不会在这里真的压缩
+        SelectEncoding_();
+        if(compress_ && !CompressBody_()){
+            encoding_ = nullptr;//还在后台压缩、压缩失败或没有变小，按原样发送
+        }
+        if(NotModified_()){
+            code_ = 304;
+        }else if(!range_.empty() && !ParseRange_()){
+            code_ = 416;
+        }
+    }
     ErrorHtml_();
     AddStateLine_(buff);
     AddHeader_(buff);
@@ -87,13 +160,169 @@ char* HttpResponse::File(){
 }
 
 size_t HttpResponse::FileLen()const{
-    return mmFileStat_.st_size;
+    if(compressed_)return compressed_->size();
+    return (mmFile_ || fileFd_ >= 0) ? mmFileStat_.st_size : 0;
+}
+
+//打开文件并包装成FileEntry，发送方持有引用即可保证fd/映射有效
+FilePtr HttpResponse::OpenFile_(const string& path, const struct stat& st){
+    int srcFd = open((srcDir_ + path).data(), O_RDONLY);
+    if(srcFd < 0){
+        return nullptr;
+    }
+    LOG_DEBUG("file path %s", (srcDir_ + path).data());
+    shared_ptr<FileEntry> entry = make_shared<FileEntry>();
+    entry->exists = true;
+    entry->st = st;
+    entry->mime = FileType(path);
+    if(sendMode != MMAP_WRITEV || st.st_size == 0){
+        //零拷贝模式下不映射文件，保留fd，由HttpConn用sendfile/splice直接从页缓存发出
+        entry->fd = srcFd;
+    }else{
+        //使用 mmap 函数将文件内容映射到进程的虚拟内存空间中，并返回一个指向映射内存的指针
+        //MAP_PRIVATE表示映射内存是私有的，对内存的修改不会写回文件
+        void* mmRet = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
+        close(srcFd);
+        if(mmRet == MAP_FAILED){
+            return nullptr;
+        }
+        entry->mmFile = (char*)mmRet;
+    }
+    return entry;
+}
+
+int HttpResponse::AcceptEncodings(const StrSpan& header){
+    bool compress = CompressCache::Instance()->IsOpen();
+    if(header.empty() || (!gzipStatic && !compress))return 0;
+    int accepted = 0, rejected = 0;
+    bool any = false;
+    const char* p = header.data;
+    const char* end = header.data + header.len;
+    while(p < end){
+        //每一项形如 gzip;q=0.8
+        const char* itemEnd = Scanner::FindChar(p, end, ',');
+        const char* nameEnd = Scanner::FindChar(p, itemEnd, ';');
+        while(p < nameEnd && (*p == ' ' || *p == '\t'))p++;
+        const char* e = nameEnd;
+        while(e > p && (e[-1] == ' ' || e[-1] == '\t'))e--;
+        bool zero = false;
+        for(const char* q = nameEnd; q + 2 < itemEnd; q++){
+            if((q[0] == 'q' || q[0] == 'Q') && q[1] == '='){
+                //q=0、q=0.0等表示明确不接受
+                const char* v = q + 2;
+                zero = *v == '0';
+                for(v++; zero && v < itemEnd && *v != ' ' && *v != ';'; v++){
+                    zero = *v == '.' || *v == '0';
+                }
+                break;
+            }
+        }
+        StrSpan name(p, e - p);
+        int bit = 0;
+        if(name.EqualsIgnoreCase("br"))bit = ACCEPT_BR;
+        else if(name.EqualsIgnoreCase("gzip") || name.EqualsIgnoreCase("x-gzip"))bit = ACCEPT_GZIP;
+        else if(name.EqualsIgnoreCase("deflate"))bit = ACCEPT_DEFLATE;
+        else if(name.Equals("*"))any = !zero;
+        if(bit)(zero ? rejected : accepted) |= bit;
+        p = itemEnd + 1;
+    }
+    if(any)accepted |= ACCEPT_BR | ACCEPT_GZIP | ACCEPT_DEFLATE;
+    accepted &= ~rejected;
+    if(!gzipStatic)accepted &= ~ACCEPT_BR;     //br只能发预压缩文件
+    if(!compress && !gzipStatic)accepted = 0;
+    if(!compress)accepted &= ~ACCEPT_DEFLATE;  //deflate只用于即时压缩
+    return accepted;
+}
+
+bool HttpResponse::Compressible_(const string& mime){
+    return mime.compare(0, 5, "text/") == 0 || mime.find("xml") != string::npos ||
+           mime.find("javascript") != string::npos || mime.find("json") != string::npos;
+}
+
+//按Accept-Encoding选择编码：预压缩的.br > .gz > 即时gzip > 即时deflate；Range请求只发原文件
+void HttpResponse::SelectEncoding_(){
+    bool compressible = Compressible_(GetFileType_());
+    bool compress = compressible && CompressCache::Instance()->IsOpen() &&
+        mmFileStat_.st_size >= CompressCache::MIN_SIZE && mmFileStat_.st_size <= CompressCache::MAX_SIZE;
+    vary_ = compressible || gzipStatic;
+    if(acceptEnc_ == 0 || !range_.empty())return;
+    if(gzipStatic){
+        if((acceptEnc_ & ACCEPT_BR) && UseSibling_(".br")){
+            encoding_ = "br";
+            return;
+        }
+        if((acceptEnc_ & ACCEPT_GZIP) && UseSibling_(".gz")){
+            encoding_ = "gzip";
+            return;
+        }
+    }
+    if(compress && (acceptEnc_ & (ACCEPT_GZIP | ACCEPT_DEFLATE))){
+        encoding_ = (acceptEnc_ & ACCEPT_GZIP) ? "gzip" : "deflate";
+        compress_ = true;
+    }
+}
+
+//把正文换成同目录下的预压缩文件，之后的ETag/Last-Modified/长度都以它为准
+bool HttpResponse::UseSibling_(const char* suffix){
+    string path = path_ + suffix;
+    FilePtr file;
+    if(FileCache::Instance()->IsOpen()){
+        file = FileCache::Instance()->Get(path);
+        if(!file || !file->exists || !S_ISREG(file->st.st_mode) || file->fd < 0)return false;
+    }else{
+        struct stat st;
+        if(stat((srcDir_ + path).data(), &st) < 0 || !S_ISREG(st.st_mode) || !(st.st_mode & S_IROTH)){
+            return false;
+        }
+        file = OpenFile_(path, st);
+        if(!file)return false;
+    }
+    file_ = file;
+    mmFileStat_ = file->st;
+    bodyPath_ = path;
+    return true;
+}
+
+bool HttpResponse::CompressBody_(){
+    if(!file_ || (file_->fd < 0 && !file_->mmFile)){
+        file_ = OpenFile_(path_, mmFileStat_);
+        if(!file_)return false;
+    }
+    CompressCache::ENCODING encoding = strcmp(encoding_, "gzip") == 0 ?
+        CompressCache::GZIP : CompressCache::DEFLATE;
+    compressed_ = CompressCache::Instance()->Get(file_, encoding, &compressPending_);
+    return compressed_ != nullptr;
+}
+
+//目录列表：正文由DirListProducer在发送时逐段生成
+bool HttpResponse::OpenDirList_(){
+    shared_ptr<DirListProducer> producer = make_shared<DirListProducer>(srcDir_ + path_, path_);
+    if(!producer->IsOpen())return false;
+    producer_ = producer;
+    return true;
+}
+
+//获取文件信息，优先从文件缓存取，省掉stat/open
+bool HttpResponse::StatFile_(){
+    file_.reset();
+    if(FileCache::Instance()->IsOpen()){
+        file_ = FileCache::Instance()->Get(path_);
+        if(file_){
+            mmFileStat_ = file_->st;
+            return file_->exists;
+        }
+    }
+    return stat((srcDir_ + path_).data(), &mmFileStat_) == 0;
+}
+
+bool HttpResponse::HasErrorPage_() const{
+    return code_ < 400 || CODE_PATH.count(code_) == 1;
 }
 
 void HttpResponse::ErrorHtml_(){
     if(CODE_PATH.count(code_) == 1){
         path_ = CODE_PATH.find(code_)->second;
-        stat((srcDir_ + path_).data(), &mmFileStat_);
+        StatFile_();
     }
 }
 
@@ -116,37 +345,264 @@ void HttpResponse::AddHeader_(Buffer& buff){
     }else{
         buff.Append("close\r\n");
     }
-    buff.Append("Content-type: " + GetFileType_() + "\r\n");
+    if(ranges_.size() > 1){
+        buff.Append("Content-type: multipart/byteranges; boundary=" + Boundary_() + "\r\n");
+    }else if(code_ != 304){
+        buff.Append("Content-type: " + GetFileType_() + "\r\n");
+    }
+    if((code_ == 200 || code_ == 206 || code_ == 304) && S_ISREG(mmFileStat_.st_mode) && !producer_){
+        AddValidators_(buff);
+    }
+}
+
+void HttpResponse::AddValidators_(Buffer& buff){
+    buff.Append("Last-Modified: " + HttpDate(mmFileStat_.st_mtime) + "\r\n");
+    buff.Append("ETag: " + ETag_() + "\r\n");
+    if(encoding_){
+        buff.Append("Content-Encoding: " + string(encoding_) + "\r\n");
+    }
+    if(vary_){
+        buff.Append("Vary: Accept-Encoding\r\n");
+    }
+    for(const auto& item: cacheControl_){
+        if(path_.compare(0, item.first.size(), item.first) == 0){
+            buff.Append("Cache-Control: " + item.second + "\r\n");
+            break;
+        }
+    }
+}
+
+string HttpResponse::ETag_() const{
+    string etag = (file_ && !file_->etag.empty()) ? file_->etag : StatETag(mmFileStat_);
+    if(encoding_ && etag.size() >= 2){
+        //不同编码是不同的表示，ETag也要不同，如 "5f1e2d3c-2dc6c0-gzip"
+        etag.insert(etag.size() - 1, string("-") + encoding_);
+    }
+    return etag;
+}
+
+//由修改时间和大小生成，形如 "5f1e2d3c-2dc6c0"
+string HttpResponse::StatETag(const struct stat& st){
+    char etag[48];
+    snprintf(etag, sizeof(etag), "\"%llx-%llx\"",
+        (unsigned long long)st.st_mtime, (unsigned long long)st.st_size);
+    return etag;
+}
+
+//If-None-Match存在时只看它(弱比较)，否则看If-Modified-Since
+bool HttpResponse::NotModified_() const{
+    if(!ifNoneMatch_.empty()){
+        return MatchETag_(ifNoneMatch_, ETag_());
+    }
+    if(ifModifiedSince_.empty())return false;
+    if(ifModifiedSince_ == HttpDate(mmFileStat_.st_mtime))return true;
+    struct tm tm = {0};
+    const char* end = strptime(ifModifiedSince_.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if(!end || *end != '\0')return false;
+    return mmFileStat_.st_mtime <= timegm(&tm);
+}
+
+//list为 * 或逗号分隔的ETag列表，忽略W/前缀
+bool HttpResponse::MatchETag_(const string& list, const string& etag){
+    const char* p = list.data();
+    const char* end = p + list.size();
+    while(p < end){
+        while(p < end && (*p == ' ' || *p == '\t' || *p == ','))p++;
+        if(p == end)break;
+        if(*p == '*')return true;
+        if(end - p > 2 && p[0] == 'W' && p[1] == '/')p += 2;
+        const char* tagEnd = p;
+        if(*p == '"'){
+            tagEnd = p + 1;
+            while(tagEnd < end && *tagEnd != '"')tagEnd++;
+            if(tagEnd < end)tagEnd++;
+        }else{
+            while(tagEnd < end && *tagEnd != ',')tagEnd++;
+        }
+        if((size_t)(tagEnd - p) == etag.size() && memcmp(p, etag.data(), etag.size()) == 0){
+            return true;
+        }
+        p = tagEnd;
+    }
+    return false;
 }
 
 void HttpResponse::AddContent_(Buffer& buff){
-    int srcFd = open((srcDir_ + path_).data(), O_RDONLY);
-    if(srcFd < 0){
-        ErrorContent(buff, "File NotFound!");
+    if(!HasErrorPage_()){
+        if(code_ == 416){
+            buff.Append("Content-Range: bytes */" + to_string(mmFileStat_.st_size) + "\r\n");
+        }
+        //没有对应错误页的状态码，生成简单的正文
+        ErrorContent(buff, CODE_STATUS.find(code_)->second);
         return;
     }
-
-    LOG_DEBUG("file path %s", (srcDir_ + path_).data());
-    //使用 mmap 函数将文件内容映射到进程的虚拟内存空间中，并返回一个指向映射内存的指针
-    //MAP_PRIVATE表示映射内存是私有的，对内存的修改不会写回文件
-    int* mmRet = (int*)mmap(0, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if(*mmRet == -1){
+    if(code_ == 304){
+        //客户端的缓存仍然有效，不需要正文，也不用打开/映射文件
+        buff.Append("\r\n");
+        return;
+    }
+    if(producer_){
+        //长度未知：保持连接时用chunked分块，否则一直发到关闭连接为止
+        chunked_ = isKeepAlive_;
+        buff.Append(chunked_ ? "Transfer-Encoding: chunked\r\n\r\n" : "\r\n");
+        return;
+    }
+    if(compressed_){
+        //即时压缩的结果在内存里，和响应头一起writev
+        mmFile_ = const_cast<char*>(compressed_->data());
+        buff.Append("Content-length: " + to_string(compressed_->size()) + "\r\n\r\n");
+        return;
+    }
+    if(!file_){
+        //没有文件缓存：本次打开的fd/映射也包装成FileEntry
+        file_ = OpenFile_(path_, mmFileStat_);
+        if(!file_){
+            ErrorContent(buff, "File NotFound!");
+            return;
+        }
+    }else if(file_->fd < 0 && !file_->mmFile){
         ErrorContent(buff, "File NotFound!");
         return;
     }
-    mmFile_ = (char*)mmRet;
-    close(srcFd);
+    //命中缓存时直接复用缓存里打开的fd和映射，不再open/mmap
+    if(file_->mmFile && (sendMode == MMAP_WRITEV || file_->fd < 0)){
+        mmFile_ = file_->mmFile;
+    }else{
+        fileFd_ = file_->fd;
+    }
+    if(code_ == 206){
+        AddRangeContent_(buff);
+        return;
+    }
+    if(code_ == 200){
+        buff.Append("Accept-Ranges: bytes\r\n");
+    }
     buff.Append("Content-length: " + to_string(mmFileStat_.st_size) + "\r\n\r\n");
 }
 
+//解析Range头，得到要发送的各段；返回false表示所有段都不可满足(416)。
+//语法错误、If-Range不匹配或段数过多时忽略Range，按200发送整个文件
+bool HttpResponse::ParseRange_(){
+    if(!ifRange_.empty()){
+        //If-Range可以是ETag(强比较)或日期，不匹配说明文件已经变了，客户端需要整个新文件
+        bool isETag = ifRange_[0] == '"' || ifRange_.compare(0, 2, "W/") == 0;
+        if(isETag ? ifRange_ != ETag_() : ifRange_ != HttpDate(mmFileStat_.st_mtime)){
+            return true;
+        }
+    }
+    if(range_.compare(0, 6, "bytes=") != 0){
+        return true;
+    }
+    size_t size = mmFileStat_.st_size;
+    vector<FileRange> ranges;
+    size_t specs = 0;
+    const char* p = range_.data() + 6;
+    const char* end = range_.data() + range_.size();
+    while(p < end){
+        const char* specEnd = p;
+        while(specEnd < end && *specEnd != ',')specEnd++;
+        const char* b = p;
+        const char* e = specEnd;
+        p = specEnd + 1;
+        while(b < e && (*b == ' ' || *b == '\t'))b++;
+        while(e > b && (e[-1] == ' ' || e[-1] == '\t'))e--;
+        if(b == e)continue;//允许空的列表项
+        if(++specs > MAX_RANGES)return true;
+
+        const char* dash = b;
+        while(dash < e && *dash != '-')dash++;
+        if(dash == e)return true;
+        bool hasFirst = dash > b, hasLast = dash + 1 < e;
+        size_t first = 0, last = 0;
+        for(const char* q = b; q < dash; q++){
+            if(*q < '0' || *q > '9' || first > (SIZE_MAX - 9) / 10)return true;
+            first = first * 10 + (*q - '0');
+        }
+        for(const char* q = dash + 1; q < e; q++){
+            if(*q < '0' || *q > '9' || last > (SIZE_MAX - 9) / 10)return true;
+            last = last * 10 + (*q - '0');
+        }
+        if(!hasFirst && !hasLast)return true;
+        if(hasFirst && hasLast && last < first)return true;
+
+        FileRange range;
+        if(!hasFirst){//后缀形式 -N：最后N个字节
+            if(last == 0)continue;
+            range.offset = size > last ? size - last : 0;
+            range.len = size - range.offset;
+        }else{
+            if(first >= size)continue;//这一段不可满足
+            if(!hasLast || last >= size)last = size - 1;
+            range.offset = first;
+            range.len = last - first + 1;
+        }
+        ranges.push_back(range);
+    }
+    if(specs == 0)return true;
+    if(ranges.empty())return false;
+    ranges_.swap(ranges);
+    code_ = 206;
+    return true;
+}
+
+//206正文：单段直接是文件的一部分，多段用multipart/byteranges包起来
+void HttpResponse::AddRangeContent_(Buffer& buff){
+    string total = to_string(mmFileStat_.st_size);
+    if(ranges_.size() == 1){
+        const FileRange& range = ranges_[0];
+        buff.Append("Content-Range: bytes " + to_string(range.offset) + "-" +
+                    to_string(range.offset + range.len - 1) + "/" + total + "\r\n");
+        buff.Append("Content-length: " + to_string(range.len) + "\r\n\r\n");
+        return;
+    }
+    string type = GetFileType_();
+    size_t bodyLen = 0;
+    for(FileRange& range: ranges_){
+        range.head = "\r\n--" + Boundary_() + "\r\nContent-type: " + type +
+            "\r\nContent-Range: bytes " + to_string(range.offset) + "-" +
+            to_string(range.offset + range.len - 1) + "/" + total + "\r\n\r\n";
+        bodyLen += range.head.size() + range.len;
+    }
+    rangeTail_ = "\r\n--" + Boundary_() + "--\r\n";
+    bodyLen += rangeTail_.size();
+    buff.Append("Content-length: " + to_string(bodyLen) + "\r\n\r\n");
+}
+
+//multipart分隔符，进程启动时随机生成一次
+const string& HttpResponse::Boundary_(){
+    static const string boundary = [](){
+        random_device rd;
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%08x%08x", rd(), rd());
+        return string(buf);
+    }();
+    return boundary;
+}
+
+//RFC 7231的IMF-fixdate格式，如 Sun, 06 Nov 1994 08:49:37 GMT
+string HttpResponse::HttpDate(time_t t){
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char buf[32];
+    size_t n = strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return string(buf, n);
+}
+
 
 //判断文件的类型
 string HttpResponse::GetFileType_(){
-    string::size_type idx = path_.find_last_of('.');
+    if(!HasErrorPage_())return "text/html";
+    if(producer_)return producer_->ContentType();
+    if(file_ && bodyPath_.empty())return file_->mime;
+    return FileType(path_);
+}
+
+string HttpResponse::FileType(const string& path){
+    string::size_type idx = path.find_last_of('.');
     if(idx == string::npos){
         return "text/plain";
     }
-    string suffix = path_.substr(idx);
+    string suffix = path.substr(idx);
     if(SUFFIX_TYPE.count(suffix)){
         return SUFFIX_TYPE.find(suffix)->second;
     }
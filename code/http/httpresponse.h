@@ -2,6 +2,9 @@
 #define HTTP_RESPONSE_H
 
 #include<unordered_map>
+#include<vector>
+#include<time.h>
+#include<random>
 #include<fcntl.h>
 #include<unistd.h>
 #include<sys/stat.h>
@@ -9,26 +12,91 @@
 
 #include"../buffer/buffer.h"
 #include"../log/log.h"
+#include"filecache.h"
+#include"bodyproducer.h"
+#include"compresscache.h"
+#include"scanner.h"
 
 class HttpResponse{
 public:
+    //文件发送方式，启动时选定
+    enum SEND_MODE{
+        MMAP_WRITEV = 0,    //mmap映射文件，和响应头一起writev
+        SENDFILE,           //sendfile零拷贝，失败时退回splice
+        SPLICE,             //文件->管道->socket 的splice
+    };
+
+    //客户端接受的内容编码
+    enum ACCEPT_ENCODING{
+        ACCEPT_BR = 1,
+        ACCEPT_GZIP = 2,
+        ACCEPT_DEFLATE = 4,
+    };
+
+    //Range请求中的一段，多段时head为该段前的multipart分隔和段头
+    struct FileRange{
+        off_t offset;
+        size_t len;
+        std::string head;
+    };
+
     HttpResponse();
     ~HttpResponse();
 
     void Init(const std::string& srcDir, std::string& path, bool isKeepAlive = false, int code = -1);
+    void SetRange(const std::string& range, const std::string& ifRange);  //GET请求的Range/If-Range头
+    void SetConditions(const std::string& ifNoneMatch, const std::string& ifModifiedSince);
+    void SetEncodings(int accepted){acceptEnc_ = accepted;}   //AcceptEncodings的结果
     void MakeResponse(Buffer& buff);
     void UnmapFile();
     char* File();
+    int FileFd() const{return fileFd_;}
     size_t FileLen() const;
     void ErrorContent(Buffer& buff, std::string message);
     int Code() const{return code_;}
+    const std::string& Path() const{return path_;}
+    const FilePtr& FileHolder() const{return file_;}
+    const ResponseBlob& BodyBlob() const{return compressed_;}   //即时压缩的正文，File()指向它
+    const std::string& BodyPath() const{return bodyPath_.empty() ? path_ : bodyPath_;}  //实际发送的文件
+    const ProducerPtr& Producer() const{return producer_;}   //流式正文，没有时为空
+    bool IsChunked() const{return chunked_;}
+    //选了即时压缩但压缩结果还没出来，这次按原样发送；这样的响应不能进响应缓存
+    bool CompressPending() const{return compressPending_;}
+    const std::vector<FileRange>& Ranges() const{return ranges_;}    //为空时发送整个文件
+    const std::string& RangeTail() const{return rangeTail_;}        //multipart的结束分隔
+
+    static int sendMode;
+    static bool autoIndex;  //请求目录时是否流式返回目录列表
+    static bool gzipStatic; //存在同名的.br/.gz文件时直接发送它
+    //解析Accept-Encoding，只保留当前开启的功能能用上的编码，也用作响应缓存键的一部分
+    static int AcceptEncodings(const StrSpan& header);
+    static std::string FileType(const std::string& path);
+    static std::string HttpDate(time_t t);
+    static std::string StatETag(const struct stat& st);
+    //路径以prefix开头的文件响应带上Cache-Control: value，最长前缀优先；在服务启动前设置
+    static void AddCacheControl(const std::string& prefix, const std::string& value);
 
 private:
     void AddStateLine_(Buffer& buff);
     void AddHeader_(Buffer& buff);
     void AddContent_(Buffer& buff);
 
+    bool StatFile_();
     void ErrorHtml_();
+    bool HasErrorPage_() const;
+    bool OpenDirList_();
+    FilePtr OpenFile_(const std::string& path, const struct stat& st);
+    void SelectEncoding_();
+    bool UseSibling_(const char* suffix);
+    bool CompressBody_();
+    static bool Compressible_(const std::string& mime);
+    bool ParseRange_();
+    bool NotModified_() const;
+    std::string ETag_() const;
+    void AddValidators_(Buffer& buff);
+    static bool MatchETag_(const std::string& list, const std::string& etag);
+    void AddRangeContent_(Buffer& buff);
+    static const std::string& Boundary_();
     std::string GetFileType_();
 
     int code_;
@@ -38,11 +106,29 @@ private:
     std::string srcDir_;
 
     char* mmFile_; //文件映射到内存的起始位置
+    int fileFd_;   //非mmap模式下保持打开的文件描述符，交给sendfile/splice
     struct stat mmFileStat_;
+    FilePtr file_; //正文文件，来自文件缓存或本次打开；发送期间由HttpConn另外持有引用
+    ProducerPtr producer_;
+    bool chunked_;
+    std::string range_, ifRange_;
+    std::string ifNoneMatch_, ifModifiedSince_;
+    int acceptEnc_;
+    const char* encoding_;      //Content-Encoding，原样发送时为nullptr
+    bool compress_;             //encoding_需要即时压缩(而不是预压缩文件)
+    bool compressPending_;
+    bool vary_;
+    ResponseBlob compressed_;
+    std::string bodyPath_;      //发送预压缩文件时为它的路径
+    std::vector<FileRange> ranges_;
+    std::string rangeTail_;
+
 
     static const std::unordered_map<std::string, std::string>SUFFIX_TYPE;   // 后缀类型集
     static const std::unordered_map<int, std::string>CODE_STATUS;           // 编码状态集
     static const std::unordered_map<int, std::string>CODE_PATH;             // 编码路径集
+    static std::vector<std::pair<std::string, std::string>> cacheControl_;  //按前缀长度从长到短
+    static const size_t MAX_RANGES = 16;    //超过这么多段时忽略Range，返回整个文件
 
 };
 
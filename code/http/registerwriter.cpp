@@ -0,0 +1,171 @@
+#include "registerwriter.h"
+
+using namespace std;
+
+const unsigned int RegisterWriter::DUP_ENTRY;
+
+RegisterWriter* RegisterWriter::Instance(){
+    static RegisterWriter writer;
+    return &writer;
+}
+
+RegisterWriter::RegisterWriter():maxBatch_(0), windowUs_(0), maxPending_(0), isOpen_(false),
+    batches_(0), inserted_(0), rejected_(0){}
+
+RegisterWriter::~RegisterWriter(){
+    Close();
+}
+
+void RegisterWriter::Init(int maxBatch, int windowUs, size_t maxPending){
+    assert(maxBatch > 0);
+    Close();
+    maxBatch_ = maxBatch;
+    windowUs_ = windowUs > 0 ? windowUs : 0;
+    maxPending_ = maxPending;
+    batches_ = inserted_ = rejected_ = 0;
+    isOpen_ = true;
+    thread_ = thread(&RegisterWriter::Run_, this);
+}
+
+void RegisterWriter::Close(){
+    {
+        lock_guard<mutex> locker(mtx_);
+        if(!isOpen_ && !thread_.joinable())return;
+        isOpen_ = false;
+        if(!rows_.empty()){
+            LOG_WARN("RegisterWriter drop %d pending rows", (int)rows_.size());
+            rows_.clear();
+        }
+    }
+    cond_.notify_all();
+    if(thread_.joinable())thread_.join();
+    if(batches_ > 0){
+        LOG_INFO("RegisterWriter batches: %llu, inserted: %llu, rejected: %llu",
+            (unsigned long long)batches_, (unsigned long long)inserted_, (unsigned long long)rejected_);
+    }
+}
+
+bool RegisterWriter::Submit(const string& name, const string& pwd, function<void(bool)> done){
+    assert(done);
+    size_t size;
+    {
+        lock_guard<mutex> locker(mtx_);
+        if(!isOpen_)return false;
+        if(rows_.size() >= maxPending_){
+            LOG_WARN("RegisterWriter busy, %d rows pending", (int)rows_.size());
+            return false;
+        }
+        rows_.push_back(Row{name, pwd, std::move(done), Clock::now()});
+        size = rows_.size();
+    }
+    //只有写线程在等第一行或等攒满时才需要叫醒
+    if(size == 1 || size == (size_t)maxBatch_)cond_.notify_one();
+    return true;
+}
+
+void RegisterWriter::Run_(){
+    vector<Row> batch;
+    unique_lock<mutex> locker(mtx_);
+    while(true){
+        cond_.wait(locker, [this]{ return !isOpen_ || !rows_.empty(); });
+        if(!isOpen_)break;
+        //第一行到达后再等一个窗口，让同一波注册落进同一批；上一批写入期间到达的已经等够了
+        Clock::time_point deadline = rows_.front().arrive + chrono::microseconds(windowUs_);
+        cond_.wait_until(locker, deadline, [this]{ return !isOpen_ || rows_.size() >= (size_t)maxBatch_; });
+        if(!isOpen_)break;
+        while(!rows_.empty() && batch.size() < (size_t)maxBatch_){
+            batch.push_back(std::move(rows_.front()));
+            rows_.pop_front();
+        }
+        locker.unlock();
+        Commit_(batch);
+        batch.clear();
+        locker.lock();
+    }
+}
+
+void RegisterWriter::Commit_(vector<Row>& rows){
+    batches_++;
+    vector<char> ok(rows.size(), 0);
+    vector<Row*> pending;
+    for(size_t i = 0; i < rows.size(); i++){
+        //缓存里已有的用户不用再查
+        AuthCache::RESULT cached = AuthCache::Instance()->Lookup(rows[i].name, rows[i].pwd);
+        if(cached != AuthCache::MATCH && cached != AuthCache::MISMATCH){
+            pending.push_back(&rows[i]);
+        }
+    }
+
+    if(!pending.empty()){
+        MYSQL* sql;
+        SqlConnRAII sqlRAII(&sql, SqlConnPool::Instance());
+        vector<char> inserted(pending.size(), 0);
+        //用户名是否相同由数据库按列的排序规则判断(大小写、尾部空格)，不在这里比较字符串：
+        //整批在一个事务里逐行条件插入，批内先写入的行对后面的行可见，整批只提交一次
+        if(sql && !mysql_autocommit(sql, 0)){
+            bool good = true;
+            for(size_t i = 0; i < pending.size() && good; i++){
+                bool taken = false;
+                good = InsertRow_(sql, *pending[i], &taken);
+                inserted[i] = good && !taken;
+            }
+            if(!good || mysql_commit(sql)){
+                LOG_ERROR("RegisterWriter commit %d rows error: %s", (int)pending.size(), mysql_error(sql));
+                mysql_rollback(sql);
+                fill(inserted.begin(), inserted.end(), 0);
+            }
+            if(mysql_autocommit(sql, 1)){
+                //连接还停在事务模式，不能再给别人用
+                SqlConnPool::Instance()->ResetStmts(sql);
+            }
+        }
+        for(size_t i = 0; i < pending.size(); i++){
+            ok[pending[i] - &rows[0]] = inserted[i];
+            if(inserted[i]){
+                //之前缓存的查无此人作废
+                AuthCache::Instance()->Invalidate(pending[i]->name);
+                inserted_++;
+            }
+        }
+    }
+
+    for(size_t i = 0; i < rows.size(); i++){
+        if(!ok[i])rejected_++;
+        rows[i].done(ok[i] != 0);
+    }
+    LOG_DEBUG("RegisterWriter commit %d rows", (int)rows.size());
+}
+
+//用户名不存在时插入；已存在(包括同一事务里刚插入的)时taken置为true。出错返回false
+bool RegisterWriter::InsertRow_(MYSQL* sql, const Row& row, bool* taken){
+    MYSQL_STMT* stmt = SqlConnPool::Instance()->GetStmt(sql,
+        "INSERT INTO user(username, password) SELECT ?, ? FROM DUAL "
+        "WHERE NOT EXISTS (SELECT 1 FROM user WHERE username = ?)");
+    *taken = false;
+    if(!stmt)return false;
+
+    MYSQL_BIND params[3];
+    memset(params, 0, sizeof(params));
+    const string* fields[3] = {&row.name, &row.pwd, &row.name};
+    unsigned long lens[3];
+    for(int k = 0; k < 3; k++){
+        lens[k] = fields[k]->size();
+        params[k].buffer_type = MYSQL_TYPE_STRING;
+        params[k].buffer = (void*)fields[k]->data();
+        params[k].buffer_length = lens[k];
+        params[k].length = &lens[k];
+    }
+
+    if(mysql_stmt_bind_param(stmt, params) || mysql_stmt_execute(stmt)){
+        //表上有唯一键时，并发写入的同名用户在这里报重名，是正常的业务结果
+        if(mysql_stmt_errno(stmt) == DUP_ENTRY){
+            *taken = true;
+            return true;
+        }
+        LOG_ERROR("Mysql insert user error: %s", mysql_stmt_error(stmt));
+        SqlConnPool::Instance()->ResetStmts(sql);
+        return false;
+    }
+    *taken = mysql_stmt_affected_rows(stmt) == 0;
+    return true;
+}
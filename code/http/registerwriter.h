@@ -0,0 +1,70 @@
+#ifndef REGISTER_WRITER_H
+#define REGISTER_WRITER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <string.h>
+#include <assert.h>
+#include <mysql/mysql.h>
+
+#include "../log/log.h"
+#include "../pool/sqlconnpool.h"
+#include "authcache.h"
+
+//注册的组提交：并发的注册请求交给一个专用的写线程，在很短的时间窗口内攒成一批，
+//在一个事务里逐行做"不存在才插入"，整批只提交一次。重名由数据库按排序规则判断。
+//每一行的结果(成功或重名)单独回调给各自的连接
+class RegisterWriter{
+public:
+    static RegisterWriter* Instance();
+
+    //maxBatch为一批的最大行数，windowUs为第一行到达后最多等待攒批的时间，maxPending为排队上限
+    void Init(int maxBatch, int windowUs, size_t maxPending = 4096);
+    void Close();       //不再接收注册，丢弃还没写入的，等正在写的一批完成
+    bool IsOpen() const { return isOpen_; }
+
+    //在写线程上回调done，true为注册成功；未启动或排队已满时返回false
+    bool Submit(const std::string& name, const std::string& pwd, std::function<void(bool)> done);
+
+private:
+    RegisterWriter();
+    ~RegisterWriter();
+
+    typedef std::chrono::steady_clock Clock;
+
+    struct Row{
+        std::string name;
+        std::string pwd;
+        std::function<void(bool)> done;
+        Clock::time_point arrive;
+    };
+
+    void Run_();
+    void Commit_(std::vector<Row>& rows);
+    bool InsertRow_(MYSQL* sql, const Row& row, bool* taken);
+
+    static const unsigned int DUP_ENTRY = 1062;     //ER_DUP_ENTRY
+
+    int maxBatch_;
+    int windowUs_;
+    size_t maxPending_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    std::deque<Row> rows_;
+    std::thread thread_;
+    std::atomic<bool> isOpen_;
+
+    uint64_t batches_;          //只在写线程上修改
+    uint64_t inserted_;
+    uint64_t rejected_;
+};
+
+#endif
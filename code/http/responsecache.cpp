@@ -0,0 +1,118 @@
+#include "responsecache.h"
+
+using namespace std;
+
+ResponseCache* ResponseCache::Instance(){
+    static ResponseCache cache;
+    return &cache;
+}
+
+ResponseCache::ResponseCache():shardCapacity_(0), maxFileSize_(0), isOpen_(false),
+    hits_(0), misses_(0), evictions_(0){}
+
+ResponseCache::~ResponseCache(){
+    Close();
+}
+
+bool ResponseCache::Init(size_t capacity, size_t maxFileSize){
+    Close();
+    //文件变化靠FileCache感知，没有它就无法保证缓存内容是新的
+    if(capacity == 0 || !FileCache::Instance()->IsOpen())return false;
+    shardCapacity_ = (capacity + SHARD_NUM - 1) / SHARD_NUM;
+    maxFileSize_ = maxFileSize;
+    hits_ = misses_ = evictions_ = 0;
+    isOpen_ = true;
+    return true;
+}
+
+void ResponseCache::Close(){
+    if(isOpen_){
+        LOG_INFO("ResponseCache hits: %llu, misses: %llu, evictions: %llu",
+            (unsigned long long)hits_, (unsigned long long)misses_, (unsigned long long)evictions_);
+    }
+    isOpen_ = false;
+    for(auto& shard: shards_){
+        lock_guard<mutex> locker(shard.mtx);
+        shard.index.clear();
+        shard.lru.clear();
+        shard.bytes = 0;
+    }
+}
+
+string ResponseCache::Key_(const string& reqPath, bool isKeepAlive, int encodings){
+    //同一个文件的响应只随Connection和可接受的编码变化
+    return (isKeepAlive ? "K" : "C") + string(1, 'a' + encodings) + reqPath;
+}
+
+ResponseCache::Shard& ResponseCache::ShardOf_(const string& key){
+    return shards_[hash<string>()(key) % SHARD_NUM];
+}
+
+void ResponseCache::Erase_(Shard& shard, const string& key){
+    auto it = shard.index.find(key);
+    if(it == shard.index.end())return;
+    shard.bytes -= it->second->blob->size();
+    shard.lru.erase(it->second);
+    shard.index.erase(it);
+}
+
+ResponseBlob ResponseCache::Get(const string& reqPath, bool isKeepAlive, int encodings){
+    if(!isOpen_)return nullptr;
+    string key = Key_(reqPath, isKeepAlive, encodings);
+    Shard& shard = ShardOf_(key);
+    Entry entry;
+    {
+        lock_guard<mutex> locker(shard.mtx);
+        auto it = shard.index.find(key);
+        if(it == shard.index.end()){
+            misses_++;
+            return nullptr;
+        }
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        entry = *it->second;
+    }
+
+    //文件被修改、创建或删除后FileCache里会是新的缓存项
+    FilePtr reqFile = FileCache::Instance()->Get(reqPath);
+    bool fresh = reqFile && reqFile == entry.reqFile.lock();
+    if(fresh && entry.bodyPath != reqPath){
+        FilePtr bodyFile = FileCache::Instance()->Get(entry.bodyPath);
+        fresh = bodyFile && bodyFile == entry.bodyFile.lock();
+    }
+    if(!fresh){
+        lock_guard<mutex> locker(shard.mtx);
+        auto it = shard.index.find(key);
+        if(it != shard.index.end() && it->second->blob == entry.blob){
+            Erase_(shard, key);
+        }
+        misses_++;
+        return nullptr;
+    }
+    hits_++;
+    return entry.blob;
+}
+
+void ResponseCache::Put(const string& reqPath, bool isKeepAlive, int encodings, const string& bodyPath,
+                        const FilePtr& bodyFile, ResponseBlob blob){
+    if(!isOpen_ || !blob || !bodyFile || blob->size() > shardCapacity_)return;
+    FilePtr reqFile = (bodyPath == reqPath) ? bodyFile : FileCache::Instance()->Get(reqPath);
+    if(!reqFile)return;
+
+    Entry entry;
+    entry.key = Key_(reqPath, isKeepAlive, encodings);
+    entry.blob = std::move(blob);
+    entry.bodyPath = bodyPath;
+    entry.reqFile = reqFile;
+    entry.bodyFile = bodyFile;
+
+    Shard& shard = ShardOf_(entry.key);
+    lock_guard<mutex> locker(shard.mtx);
+    Erase_(shard, entry.key);
+    shard.bytes += entry.blob->size();
+    shard.lru.push_front(std::move(entry));
+    shard.index[shard.lru.front().key] = shard.lru.begin();
+    while(shard.bytes > shardCapacity_){
+        Erase_(shard, shard.lru.back().key);
+        evictions_++;
+    }
+}
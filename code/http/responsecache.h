@@ -0,0 +1,72 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+
+#include "filecache.h"
+#include "../log/log.h"
+
+typedef std::shared_ptr<const std::string> ResponseBlob;
+
+//小文件的完整响应(状态行+头部+正文)缓存，命中时HttpConn直接把iov指向缓存的只读内存，
+//不再拼接头部、也不碰文件。依赖FileCache判断文件是否变化
+class ResponseCache{
+public:
+    static ResponseCache* Instance();
+
+    //capacity为缓存总字节数上限，为0时关闭；只缓存正文不超过maxFileSize的响应
+    bool Init(size_t capacity, size_t maxFileSize = 16 * 1024);
+    void Close();
+    bool IsOpen() const { return isOpen_; }
+    size_t MaxFileSize() const { return maxFileSize_; }
+
+    //reqPath为解析后的请求路径，bodyPath为实际发送的文件(错误页、预压缩文件时二者不同)；
+    //encodings为HttpResponse::AcceptEncodings的结果，同一路径不同编码分别缓存
+    ResponseBlob Get(const std::string& reqPath, bool isKeepAlive, int encodings);
+    void Put(const std::string& reqPath, bool isKeepAlive, int encodings, const std::string& bodyPath,
+             const FilePtr& bodyFile, ResponseBlob blob);
+
+    uint64_t Hits() const { return hits_; }
+    uint64_t Misses() const { return misses_; }
+    uint64_t Evictions() const { return evictions_; }
+
+private:
+    ResponseCache();
+    ~ResponseCache();
+
+    struct Entry{
+        std::string key;
+        ResponseBlob blob;
+        std::string bodyPath;
+        std::weak_ptr<const FileEntry> reqFile;    //生成时请求路径和正文文件对应的缓存项，
+        std::weak_ptr<const FileEntry> bodyFile;   //FileCache里换了新项说明文件变了
+    };
+
+    struct Shard{
+        std::mutex mtx;
+        size_t bytes = 0;
+        std::list<Entry> lru;       //表头为最近使用
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    };
+
+    static std::string Key_(const std::string& reqPath, bool isKeepAlive, int encodings);
+    Shard& ShardOf_(const std::string& key);
+    void Erase_(Shard& shard, const std::string& key);
+
+    static const int SHARD_NUM = 16;
+
+    size_t shardCapacity_;
+    size_t maxFileSize_;
+    std::atomic<bool> isOpen_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> evictions_;
+    Shard shards_[SHARD_NUM];
+};
+
+#endif
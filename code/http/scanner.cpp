@@ -0,0 +1,65 @@
+#include "scanner.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCANNER_X86 1
+#endif
+
+static const char* FindCharScalar(const char* begin, const char* end, char c){
+    const void* ret = memchr(begin, c, end - begin);
+    return ret ? static_cast<const char*>(ret) : end;
+}
+
+#ifdef SCANNER_X86
+//每次比较32字节，movemask得到命中位图，最低位的1就是第一个匹配
+__attribute__((target("avx2")))
+static const char* FindCharAvx2(const char* begin, const char* end, char c){
+    const __m256i needle = _mm256_set1_epi8(c);
+    const char* p = begin;
+    while(end - p >= 32){
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+        if(mask){
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return FindCharScalar(p, end, c);
+}
+
+//pcmpestri：在16字节中找needle集合里任意字符第一次出现的位置，没找到返回16
+__attribute__((target("sse4.2")))
+static const char* FindCharSse42(const char* begin, const char* end, char c){
+    const __m128i needle = _mm_set1_epi8(c);
+    const char* p = begin;
+    while(end - p >= 16){
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int idx = _mm_cmpestri(needle, 1, chunk, 16,
+            _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+        if(idx < 16){
+            return p + idx;
+        }
+        p += 16;
+    }
+    return FindCharScalar(p, end, c);
+}
+#endif
+
+Scanner::FindCharFunc Scanner::findChar_ = Scanner::Select_();
+
+Scanner::FindCharFunc Scanner::Select_(){
+#ifdef SCANNER_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))return FindCharAvx2;
+    if(__builtin_cpu_supports("sse4.2"))return FindCharSse42;
+#endif
+    return FindCharScalar;
+}
+
+const char* Scanner::Impl(){
+#ifdef SCANNER_X86
+    if(findChar_ == FindCharAvx2)return "avx2";
+    if(findChar_ == FindCharSse42)return "sse4.2";
+#endif
+    return "scalar";
+}
@@ -0,0 +1,46 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <string>
+#include <string.h>
+#include <strings.h>
+
+//不拥有内存的字符串片段，类似string_view，指向的内存由提供方负责
+struct StrSpan{
+    const char* data;
+    size_t len;
+
+    StrSpan():data(""), len(0){}
+    StrSpan(const char* d, size_t l):data(d), len(l){}
+
+    bool empty() const { return len == 0; }
+    std::string str() const { return std::string(data, len); }
+
+    bool Equals(const char* s) const {
+        return strlen(s) == len && memcmp(data, s, len) == 0;
+    }
+    bool EqualsIgnoreCase(const char* s) const {
+        return strlen(s) == len && strncasecmp(data, s, len) == 0;
+    }
+    bool StartsWithIgnoreCase(const char* s) const {
+        size_t n = strlen(s);
+        return n <= len && strncasecmp(data, s, n) == 0;
+    }
+};
+
+//分隔符扫描，启动时按CPU支持情况选择 AVX2 / SSE4.2 / 标量 实现
+class Scanner{
+public:
+    //在[begin, end)中查找字符c，找不到返回end
+    static const char* FindChar(const char* begin, const char* end, char c){
+        return findChar_(begin, end, c);
+    }
+    static const char* Impl();   //当前使用的实现名，用于日志
+
+private:
+    typedef const char* (*FindCharFunc)(const char*, const char*, char);
+    static FindCharFunc Select_();
+    static FindCharFunc findChar_;
+};
+
+#endif
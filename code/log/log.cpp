@@ -1,5 +1,17 @@
 #include "log.h"
 
+const int Log::FLUSH_INTERVAL_MS;
+
+//线程退出时只做标记，缓冲区里剩下的日志由写线程写完后再释放
+namespace{
+struct LocalHolder{
+    std::shared_ptr<void> buf;
+    std::atomic<bool>* exited = nullptr;
+    ~LocalHolder(){ if(exited)exited->store(true, std::memory_order_release); }
+};
+thread_local LocalHolder localBuf;
+}
+
 //init 和 write函数是重点
 Log* Log::Instance(){
     static Log log;
@@ -10,172 +22,384 @@ void Log::FlushLogThread(){
     Log::Instance()->AsyncWrite_();
 }
 
+Log::LogBuffer::LogBuffer(size_t capacity):head(0), tail(0), exited(false), sec(0){
+    size_t size = 4096;
+    while(size < capacity)size <<= 1;
+    data.reset(new char[size]);
+    mask = size - 1;
+    stamp[0] = '\0';
+}
+
+//后台线程：每FLUSH_INTERVAL_MS或有缓冲区快满时醒来，把所有缓冲区写进文件，一轮只落盘一次
 void Log::AsyncWrite_(){
-    string str = "";
-    while(deque_->pop(str)){
-        lock_guard<mutex>locker(mtx_);
-        fputs(str.c_str(), fp_);
+    unique_lock<mutex> locker(mtx_);
+    while(true){
+        cond_.wait_for(locker, chrono::milliseconds(FLUSH_INTERVAL_MS), [this]{
+            return wakeup_.load(memory_order_relaxed) || isClosing_;
+        });
+        wakeup_.store(false, memory_order_relaxed);
+        DrainAll_();
+        if(fp_)fflush(fp_);
+        if(isClosing_)break;
     }
 }
 
 void Log::flush(){
-    if(isAsync_){
-        deque_->flush();//唤醒消费者，处理掉剩下的任务
-    }
-    fflush(fp_);//清空输入缓冲区
+    lock_guard<mutex> locker(mtx_);
+    DrainAll_();
+    if(fp_)fflush(fp_);//清空输入缓冲区
 }
 
 Log::Log(){
+    path_ = nullptr;
+    suffix_ = nullptr;
+    MAX_LINES_ = MAX_LINES;
+    isOpen_ = false;
+    level_ = 1;
     isAsync_ = false;
+    bufferSize_ = 0;
     lineCount_ = 0;
+    fileNo_ = 0;
     toDay_ = 0;
     fp_ = nullptr;
-    deque_ = nullptr;
     writeThread_ = nullptr;
+    wakeup_ = false;
+    isClosing_ = false;
+    nextDay_ = 0;
+    format_ = TEXT;
+    realBase_ = monoBase_ = 0;
+    outLen_ = 0;
 }
 
 Log::~Log(){
     if(writeThread_ && writeThread_->joinable()){
-        while(!deque_->empty()){
-            deque_->flush();
+        {
+            lock_guard<mutex> locker(mtx_);
+            isClosing_ = true;
         }
-        deque_->close();
-        writeThread_->join(); //阻塞调用线程，等待子线程执行，用于同步
+        cond_.notify_one();
+        writeThread_->join(); //写线程退出前会把所有缓冲区写完
     }
     if(fp_){
         lock_guard<mutex>locker(mtx_);
-        flush();
+        DrainAll_();
+        fflush(fp_);
         fclose(fp_);
+        fp_ = nullptr;
     }
 }
 
-void Log::AppendLogLevelTitle_(int level) {
-    switch(level) {
-    case 0:
-        buff_.Append("[debug]: ", 9);
-        break;
-    case 1:
-        buff_.Append("[info] : ", 9);
-        break;
-    case 2:
-        buff_.Append("[warn] : ", 9);
-        break;
-    case 3:
-        buff_.Append("[error]: ", 9);
-        break;
-    default:
-        buff_.Append("[info] : ", 9);
-        break;
-    }
-}
-
-int Log::GetLevel() {
-    lock_guard<mutex> locker(mtx_);
-    return level_;
+void Log::AppendLogLevelTitle_(char* dst, int level) {
+    memcpy(dst, LogFormat::LevelTitle(level), 9);
 }
 
-void Log::SetLevel(int level) {
-    lock_guard<mutex> locker(mtx_);
+void Log::init(int level, const char* path, const char* suffix, int maxQueCapacity, int format){
     level_ = level;
-}
-
-void Log::init(int level, const char* path, const char* suffix, int maxQueCapacity){
-    level_ = level;
-    path_ = path;
-    suffix_ = suffix;
-    isOpen_ = true;
     if(maxQueCapacity){//不为0就是异步日志
-        isAsync_ = true;
-        if(!deque_){
-            unique_ptr<BlockQueue<std::string>>newdq(new BlockQueue<std::string>);
-            deque_ = move(newdq);
+        //每个线程的缓冲区按平均行长容纳maxQueCapacity行
+        bufferSize_ = (size_t)maxQueCapacity * AVG_LINE_SIZE;
+        if(!writeThread_){
             unique_ptr<thread>newThread(new thread(FlushLogThread));
             writeThread_ = move(newThread);
         }
-    }else{
-        isAsync_ = false;
     }
-
-    lineCount_ = 0;
+    if(!maxQueCapacity || (format != DEFERRED && format != BINARY)){
+        format = TEXT;  //同步写时没有写线程替它格式化
+    }
 
     time_t timer = time(nullptr);//获取从1970至今过了多少秒
-    struct tm* systime = localtime(&timer);//用localtime将秒数转化为struct tm结构体
+    struct tm systime;
+    localtime_r(&timer, &systime);//转化为struct tm结构体
     char fileName[LOG_NAME_LEN] = {0};
-
-    toDay_ = systime->tm_mday;
     //将格式化的字符串输入到filname中
-    snprintf(fileName, LOG_NAME_LEN - 1, 
-    "%s/%04d_%02d_%02d%s", path_, systime->tm_year + 1900, systime->tm_mon + 1,systime->tm_mday, suffix_);
+    snprintf(fileName, LOG_NAME_LEN - 1,
+    "%s/%04d_%02d_%02d%s", path, systime.tm_year + 1900, systime.tm_mon + 1, systime.tm_mday, suffix);
 
     {
         lock_guard<mutex>locker(mtx_);
-        buff_.RetrieveAll();
-        if(fp_){//如果之前打开过，清空并重新打开
-            flush();
+        if(fp_){//如果之前打开过，先把缓冲区里的写完再重新打开
+            DrainAll_();
+            fflush(fp_);
             fclose(fp_);
+            fp_ = nullptr;
+        }
+        path_ = path;
+        suffix_ = suffix;
+        toDay_ = systime.tm_mday;
+        lineCount_ = 0;
+        fileNo_ = 0;
+        isAsync_ = maxQueCapacity != 0;
+        format_ = format;
+        //二进制记录里的单调时钟按这一对值换算成日期时间
+        struct timespec real, mono;
+        clock_gettime(CLOCK_REALTIME, &real);
+        clock_gettime(CLOCK_MONOTONIC, &mono);
+        realBase_ = (int64_t)real.tv_sec * 1000000000 + real.tv_nsec;
+        monoBase_ = (int64_t)mono.tv_sec * 1000000000 + mono.tv_nsec;
+        if(!record_){
+            record_.reset(new char[LINE_SIZE]);
+            out_.reset(new char[OUT_SIZE]);
         }
-        fp_ = fopen(fileName, "a");//追加模式
-        if(!fp_){
+        if(!OpenFile_(fileName)){
             mkdir(path_ ,0777);
-            fp_ = fopen(fileName, "a");
+            OpenFile_(fileName);
         }
         assert(fp_ != nullptr);
     }
+    isOpen_ = true;
+}
+
+int Log::RegisterFormat(const char* format){
+    lock_guard<mutex> locker(fmtMtx_);
+    assert(formats_.size() <= LogFormat::MAX_FORMAT_ID);
+    formats_.emplace_back(format);
+    return (int)formats_.size() - 1;
+}
+
+//当前线程的缓冲区，第一次写日志时分配并登记，之后一直复用
+Log::LogBuffer* Log::LocalBuffer_(){
+    LogBuffer* buf = static_cast<LogBuffer*>(localBuf.buf.get());
+    if(buf)return buf;
+    shared_ptr<LogBuffer> created = make_shared<LogBuffer>(bufferSize_);
+    {
+        lock_guard<mutex> locker(mtx_);
+        buffers_.push_back(created);
+    }
+    localBuf.exited = &created->exited;
+    localBuf.buf = created;
+    return created.get();
 }
 
 void Log::write(int level, const char *format, ...){
+    LogBuffer* buf = LocalBuffer_();
     struct timeval now = {0, 0};
     gettimeofday(&now, nullptr);            //获取时间
-    time_t tSec = now.tv_sec;
-    struct tm *sysTime = localtime(&tSec);  //转化为本地时间
-    struct tm t = *sysTime;                 //复制其值
+    if(now.tv_sec != buf->sec){
+        //秒变了才重新转换本地时间和格式化日期
+        time_t tSec = now.tv_sec;
+        struct tm t;
+        localtime_r(&tSec, &t);
+        snprintf(buf->stamp, sizeof(buf->stamp), "%d-%02d-%02d %02d:%02d:%02d.",
+            t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+        buf->sec = now.tv_sec;
+    }
+
+    //生成一条日志信息，放在线程自己的临时区
+    char* line = buf->line;
+    size_t len = strlen(buf->stamp);
+    memcpy(line, buf->stamp, len);
+    long usec = now.tv_usec;
+    for(int i = 5; i >= 0; i--){
+        line[len + i] = '0' + usec % 10;
+        usec /= 10;
+    }
+    len += 6;
+    AppendLogLevelTitle_(line + len, level);
+    len += 9;
+
+    //按照格式写入，太长的截断，留出换行的位置
     va_list vaList;                         //处理可变参数列表
-    
-    //日期不是今天，或者超过最大行数(每达到MAX_LINES就需要新建), 就新建一个日志进行写
-    if(toDay_ != t.tm_mday || (lineCount_ && (lineCount_ % MAX_LINES == 0))){
-        unique_lock<mutex>locker(mtx_);
-        locker.unlock();
-        char newFile[LOG_NAME_LEN];
-        char tail[36] = {0};
-        snprintf(tail, 36, "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
-
-        if(toDay_ != t.tm_mday){
-            snprintf(newFile,LOG_NAME_LEN - 72, "%s/%s%s", path_, tail, suffix_);
-            toDay_ = t.tm_mday;
-            lineCount_ = 0;
+    va_start(vaList, format);
+    int m = vsnprintf(line + len, LINE_SIZE - len - 1, format, vaList);
+    va_end(vaList);
+    if(m > 0)len += (size_t)m < LINE_SIZE - len - 1 ? m : LINE_SIZE - len - 2;
+    line[len++] = '\n';
+
+    if(isAsync_.load(memory_order_relaxed)){//异步日志，先存在线程自己的缓冲区里
+        Push_(buf, line, len, level >= 2);
+    }else{//同步日志，直接写入文件里
+        lock_guard<mutex> locker(mtx_);
+        DrainAll_();
+        WriteFile_(line, len);
+        fflush(fp_);
+    }
+}
+
+void Log::Push_(LogBuffer* buf, const char* line, size_t len, bool urgent){
+    size_t head = buf->head.load(memory_order_relaxed);
+    size_t tail = buf->tail.load(memory_order_acquire);
+    size_t capacity = buf->mask + 1;
+    if(capacity - (head - tail) < len){
+        //写线程跟不上，自己把缓冲区写进文件腾出位置，不丢日志也不乱序
+        lock_guard<mutex> locker(mtx_);
+        Drain_(buf);
+        tail = head;
+    }
+    size_t pos = head & buf->mask;
+    size_t first = len < capacity - pos ? len : capacity - pos;
+    memcpy(buf->data.get() + pos, line, first);
+    memcpy(buf->data.get(), line + first, len - first);
+    buf->head.store(head + len, memory_order_release);
+    //警告、错误或跨过一半时叫醒写线程，其余情况等它定时醒来
+    bool half = head - tail < capacity / 2 && head + len - tail >= capacity / 2;
+    if((urgent || half) && !wakeup_.exchange(true, memory_order_relaxed)){
+        cond_.notify_one();
+    }
+}
+
+void Log::DrainAll_(){
+    if(!fp_)return;
+    for(size_t i = 0; i < buffers_.size();){
+        LogBuffer* buf = buffers_[i].get();
+        //先看退出标记再取，保证退出前写的都能取到
+        bool exited = buf->exited.load(memory_order_acquire);
+        Drain_(buf);
+        if(exited){
+            buffers_[i] = buffers_.back();
+            buffers_.pop_back();
         }else{
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s-%d%s", path_, tail, (lineCount_  / MAX_LINES), suffix_);
+            i++;
         }
+    }
+}
 
-        locker.lock();
-        flush();
-        fclose(fp_);
-        fp_ = fopen(newFile,"a");
-        assert(fp_ != nullptr);
+void Log::Drain_(LogBuffer* buf){
+    size_t head = buf->head.load(memory_order_acquire);
+    size_t tail = buf->tail.load(memory_order_relaxed);
+    if(head == tail)return;
+    size_t capacity = buf->mask + 1;
+    const char* data = buf->data.get();
+    if(format_.load(memory_order_relaxed) == TEXT){
+        size_t pos = tail & buf->mask;
+        size_t len = head - tail;
+        size_t first = len < capacity - pos ? len : capacity - pos;
+        WriteFile_(data + pos, first);
+        if(len > first)WriteFile_(data, len - first);
+    }else{
+        while(tail != head){
+            //记录可能跨过缓冲区末尾，这时先拼成连续的
+            size_t pos = tail & buf->mask;
+            uint32_t size;
+            for(size_t i = 0; i < sizeof(size); i++){
+                ((char*)&size)[i] = data[(pos + i) & buf->mask];
+            }
+            const char* record = data + pos;
+            if(pos + size > capacity){
+                memcpy(record_.get(), data + pos, capacity - pos);
+                memcpy(record_.get() + capacity - pos, data, size - (capacity - pos));
+                record = record_.get();
+            }
+            Consume_(record);
+            tail += size;
+        }
+        FlushOut_();
     }
-    
-    //生成一条日志信息，用buff存放
-    {
-        unique_lock<mutex>locker(mtx_);
-        lineCount_++;
-        int n = snprintf(buff_.BeginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld",
-        t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec, now.tv_usec);
-        buff_.HasWritten(n);
-
-        AppendLogLevelTitle_(level);
-        //按照格式写入
-        va_start(vaList, format);
-        int m = vsnprintf(buff_.BeginWrite(), buff_.WritableBytes(), format, vaList);
-        va_end(vaList);
-
-        buff_.HasWritten(m);
-        buff_.Append("\n\0",2);
-
-        if(isAsync_ && deque_ && !deque_->full()){//异步日志，先存在缓冲区里
-            deque_->push_back(buff_.RetrieveAllToStr());
-        }else{//同步日志，直接写入文件里
-            fputs(buff_.Peek(), fp_);
+    buf->tail.store(head, memory_order_release);
+}
+
+//DEFERRED格式生成文本攒在out_里，BINARY格式原样写进文件
+void Log::Consume_(const char* record){
+    LogRecordHeader header;
+    memcpy(&header, record, sizeof(header));
+    if(format_.load(memory_order_relaxed) == BINARY){
+        WriteRecord_(record, header.size);
+        return;
+    }
+    //一行最多LINE_SIZE的两倍，参数格式化后可能比编码时长
+    if(OUT_SIZE - outLen_ < 2 * LINE_SIZE)FlushOut_();
+    const char* fmt = Format_(header.fmtId);
+    outLen_ += LogFormat::FormatLine(header, fmt ? fmt : "<unknown format>", record,
+                                     realBase_, monoBase_, stamp_, out_.get() + outLen_, 2 * LINE_SIZE);
+}
+
+const char* Log::Format_(int fmtId){
+    if(fmtId >= (int)fmtCache_.size()){
+        lock_guard<mutex> locker(fmtMtx_);
+        for(size_t i = fmtCache_.size(); i < formats_.size(); i++){
+            fmtCache_.push_back(formats_[i].c_str());
         }
-        buff_.RetrieveAll();
     }
-}
\ No newline at end of file
+    return fmtId < (int)fmtCache_.size() ? fmtCache_[fmtId] : nullptr;
+}
+
+void Log::FlushOut_(){
+    if(outLen_ == 0)return;
+    WriteFile_(out_.get(), outLen_);
+    outLen_ = 0;
+}
+
+void Log::WriteFile_(const char* data, size_t len){
+    const char* end = data + len;
+    while(data < end){
+        Rotate_();
+        //写到当前文件的行数上限为止，剩下的换了文件再写
+        const char* p = data;
+        int left = (fileNo_ + 1) * MAX_LINES - lineCount_;
+        while(p < end && left > 0){
+            const char* nl = (const char*)memchr(p, '\n', end - p);
+            if(!nl){
+                p = end;
+                break;
+            }
+            p = nl + 1;
+            left--;
+            lineCount_++;
+        }
+        fwrite(data, 1, p - data, fp_);
+        data = p;
+    }
+}
+
+//二进制记录一条算一行，格式串在每个文件里第一次用到前写一次定义
+void Log::WriteRecord_(const char* record, size_t len){
+    Rotate_();
+    LogRecordHeader header;
+    memcpy(&header, record, sizeof(header));
+    if(header.fmtId >= defined_.size() || !defined_[header.fmtId]){
+        const char* fmt = Format_(header.fmtId);
+        char def[LINE_SIZE];
+        size_t n = LogFormat::Encode(def, sizeof(def), LogFormat::FORMAT_DEF_ID, 0, 0,
+                                     (unsigned)header.fmtId, fmt ? fmt : "<unknown format>");
+        fwrite(def, 1, n, fp_);
+        if(header.fmtId >= defined_.size())defined_.resize(header.fmtId + 1, 0);
+        defined_[header.fmtId] = 1;
+    }
+    fwrite(record, 1, len, fp_);
+    lineCount_++;
+}
+
+bool Log::OpenFile_(const char* fileName){
+    fp_ = fopen(fileName, "a");//追加模式
+    if(!fp_)return false;
+    //算出下一天的零点，之前写日志时不用每次都转换日期
+    time_t now = time(nullptr);
+    struct tm t;
+    localtime_r(&now, &t);
+    t.tm_hour = t.tm_min = t.tm_sec = 0;
+    t.tm_mday++;
+    t.tm_isdst = -1;
+    nextDay_ = mktime(&t);
+    if(format_.load(memory_order_relaxed) == BINARY){
+        //每个文件(包括追加写的)先记一对时钟，解码时据此换算时间
+        char clock[64];
+        size_t n = LogFormat::Encode(clock, sizeof(clock), LogFormat::CLOCK_ID, 0, 0, realBase_, monoBase_);
+        fwrite(clock, 1, n, fp_);
+        defined_.clear();
+    }
+    return true;
+}
+
+//日期不是今天，或者超过最大行数(每达到MAX_LINES就需要新建), 就新建一个日志进行写
+void Log::Rotate_(){
+    time_t now = time(nullptr);
+    if(now < nextDay_ && lineCount_ < (fileNo_ + 1) * MAX_LINES)return;
+    struct tm t;
+    localtime_r(&now, &t);
+
+    char newFile[LOG_NAME_LEN];
+    char tail[36] = {0};
+    snprintf(tail, 36, "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+    if(toDay_ != t.tm_mday){
+        snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s%s", path_, tail, suffix_);
+        toDay_ = t.tm_mday;
+        lineCount_ = 0;
+        fileNo_ = 0;
+    }else{
+        fileNo_ = lineCount_ / MAX_LINES;
+        snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s-%d%s", path_, tail, fileNo_, suffix_);
+    }
+    fflush(fp_);
+    fclose(fp_);
+    OpenFile_(newFile);
+    assert(fp_ != nullptr);
+}
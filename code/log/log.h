@@ -2,62 +2,137 @@
 #define LOG_H
 
 #include <mutex>
+#include <condition_variable>
 #include <string>
 #include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <time.h>
 #include <sys/time.h>
 #include <string.h>
 #include <stdarg.h>           // vastart va_end
 #include <assert.h>
 #include <sys/stat.h>         //mkdir
 #include "blockqueue.h"
+#include "logformat.h"
 #include "../buffer/buffer.h"
 
+//异步日志：每个线程把格式化好的日志追加到自己预先分配的环形缓冲区，只有这个线程写、
+//后台线程读，追加一行不加锁也不分配内存。后台线程定期(或某个缓冲区用掉一半时)把所有
+//缓冲区成块地写进文件，每轮只fflush一次，日志最多延迟FLUSH_INTERVAL_MS落盘，警告和错误会尽快落盘。
+//DEFERRED和BINARY格式下热路径连格式化也省掉，只记录格式编号、时间戳和二进制参数
 class Log {
 public:
-// 初始化日志实例（阻塞队列最大容量、日志保存路径、日志文件后缀）
-    void init(int level, const char* path = "./log", 
+    enum LOG_FORMAT{
+        TEXT,           //写日志的线程格式化
+        DEFERRED,       //写线程格式化，文件内容和TEXT一样
+        BINARY,         //文件里直接存二进制记录，用bin/logdecode还原
+    };
+
+// 初始化日志实例（队列容量、日志保存路径、日志文件后缀），maxQueueCapacity为0时同步写，
+// 同步写时只能用TEXT格式；不能和写日志并发调用
+    void init(int level, const char* path = "./log",
                 const char* suffix =".log",
-                int maxQueueCapacity = 1024);
+                int maxQueueCapacity = 1024, int format = TEXT);
 
     static Log* Instance();
-    static void FlushLogThread();   // 异步写日志公有方法，调用私有方法asyncWrite
+    static void FlushLogThread();   // 后台写线程的入口，调用私有方法AsyncWrite_
 
     void write(int level, const char *format,...);
-    void flush();
+    void flush();                   // 把所有线程缓冲区里的日志写进文件并落盘
 
-    int GetLevel();
-    void SetLevel(int level);
-    bool IsOpen() { return isOpen_; }
-    
-private:
-    Log();
-    void AppendLogLevelTitle_(int level);
-    virtual ~Log();
-    void AsyncWrite_(); // 异步写日志方法
+    bool IsDeferred() { return format_.load(std::memory_order_relaxed) != TEXT; }
+    int RegisterFormat(const char* format);     // 每个调用点第一次写日志时登记一次格式串
+    template<typename... Args>
+    void WriteDeferred(int level, int fmtId, Args... args){
+        LogBuffer* buf = LocalBuffer_();
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        size_t len = LogFormat::Encode(buf->line, LINE_SIZE, fmtId, level,
+                                       (int64_t)now.tv_sec * 1000000000 + now.tv_nsec, args...);
+        Push_(buf, buf->line, len, level >= 2);
+    }
+
+    int GetLevel() { return level_.load(std::memory_order_relaxed); }
+    void SetLevel(int level) { level_.store(level, std::memory_order_relaxed); }
+    bool IsOpen() { return isOpen_.load(std::memory_order_relaxed); }
 
 private:
     static const int LOG_PATH_LEN = 256;
     static const int LOG_NAME_LEN = 256;
     static const int MAX_LINES = 50000; //最长日志条数
+    static const int LINE_SIZE = 4096;  //单行上限，超出的截断
+    static const int AVG_LINE_SIZE = 128;       //按平均行长把队列容量换算成缓冲区字节数
+    static const int FLUSH_INTERVAL_MS = 1000;
+    static const int OUT_SIZE = 64 * 1024;      //DEFERRED格式下写线程攒够这么多文本再写文件
+
+    //一个线程的日志缓冲区，head只有所属线程修改，tail持mtx_修改
+    struct LogBuffer{
+        std::unique_ptr<char[]> data;
+        size_t mask;
+        std::atomic<size_t> head;
+        std::atomic<size_t> tail;
+        std::atomic<bool> exited;       //线程已退出，取空后释放
+        time_t sec;                     //stamp对应的秒，一秒内只做一次localtime
+        char stamp[80];
+        char line[LINE_SIZE];           //格式化一行用的临时区
+        explicit LogBuffer(size_t capacity);
+    };
 
+    Log();
+    virtual ~Log();
+    void AppendLogLevelTitle_(char* dst, int level);
+    void AsyncWrite_(); // 异步写日志方法
+    LogBuffer* LocalBuffer_();
+    void Push_(LogBuffer* buf, const char* line, size_t len, bool urgent);
+    void DrainAll_();   // 以下持mtx_调用
+    void Drain_(LogBuffer* buf);
+    void Consume_(const char* record);
+    const char* Format_(int fmtId);
+    void FlushOut_();
+    void WriteFile_(const char* data, size_t len);
+    void WriteRecord_(const char* record, size_t len);
+    bool OpenFile_(const char* fileName);
+    void Rotate_();
+
+private:
     const char* path_;
     const char* suffix_;
 
     int MAX_LINES_;
 
-    int lineCount_;
+    int lineCount_;     // 当天写入的行数
+    int fileNo_;        // 当天的第几个文件
     int toDay_;         // 按当天日期区分文件
+    time_t nextDay_;    // 下一天的零点，到了才需要检查日期
+
+    std::atomic<bool> isOpen_;
 
-    bool isOpen_;
- 
-    Buffer buff_;       // 输出的内容，缓冲区
-    int level_;         // 日志等级
-    bool isAsync_;      // 是否开启异步日志
+    std::atomic<int> level_;        // 日志等级
+    std::atomic<bool> isAsync_;     // 是否开启异步日志
+    std::atomic<int> format_;
+    size_t bufferSize_;             // 新线程缓冲区的字节数
 
     FILE* fp_;                                          //打开log的文件指针
-    std::unique_ptr<BlockQueue<std::string>> deque_;    //阻塞队列
+    std::vector<std::shared_ptr<LogBuffer>> buffers_;   //所有线程的缓冲区
     std::unique_ptr<std::thread> writeThread_;          //写线程的指针
-    std::mutex mtx_;                                    //同步日志必需的互斥量
+    std::mutex mtx_;                                    //文件、buffers_和读缓冲区使用
+    std::condition_variable cond_;
+    std::atomic<bool> wakeup_;      //有缓冲区用掉了一半，写线程提前醒来
+    bool isClosing_;
+
+    std::mutex fmtMtx_;
+    std::deque<std::string> formats_;       //下标为格式编号，deque扩容时元素不移动
+    std::vector<const char*> fmtCache_;     //以下只在写线程(持mtx_)使用，formats_的副本
+    std::vector<char> defined_;             //BINARY格式下当前文件已写过定义的格式
+    int64_t realBase_;                      //同一时刻的实时时钟和单调时钟
+    int64_t monoBase_;
+    LogFormat::StampCache stamp_;
+    std::unique_ptr<char[]> record_;        //跨过缓冲区末尾的记录拼在这里
+    std::unique_ptr<char[]> out_;
+    size_t outLen_;
 };
 
 // /用于连接多行宏
@@ -65,8 +140,12 @@ private:
     do {\
         Log* log = Log::Instance();\
         if (log->IsOpen() && log->GetLevel() <= level) {\
-            log->write(level, format, ##__VA_ARGS__); \
-            log->flush();\
+            if (log->IsDeferred()) {\
+                static const int logFmtId = log->RegisterFormat(format);\
+                log->WriteDeferred(level, logFmtId, ##__VA_ARGS__); \
+            } else {\
+                log->write(level, format, ##__VA_ARGS__); \
+            }\
         }\
     } while(0);
 
@@ -0,0 +1,189 @@
+#include "logformat.h"
+#include <stdio.h>
+
+const uint16_t LogFormat::CLOCK_ID;
+const uint16_t LogFormat::FORMAT_DEF_ID;
+const uint16_t LogFormat::MAX_FORMAT_ID;
+
+const char* LogFormat::LevelTitle(int level){
+    switch(level) {
+    case 0:
+        return "[debug]: ";
+    case 1:
+        return "[info] : ";
+    case 2:
+        return "[warn] : ";
+    case 3:
+        return "[error]: ";
+    default:
+        return "[info] : ";
+    }
+}
+
+void LogFormat::EncodeArg_(char*& p, char* end, const char* arg){
+    if(!arg)arg = "(null)";
+    size_t len = strlen(arg);
+    if(end - p < 3)return;
+    //放不下的部分截断
+    if(len > (size_t)(end - p - 3))len = end - p - 3;
+    if(len > 0xFFFF)len = 0xFFFF;
+    uint16_t n = (uint16_t)len;
+    *p++ = ARG_STR;
+    memcpy(p, &n, sizeof(n));
+    p += sizeof(n);
+    memcpy(p, arg, len);
+    p += len;
+}
+
+namespace{
+//逐个取出参数，数据不够时返回false
+struct ArgReader{
+    const char* p;
+    const char* end;
+    int left;
+
+    bool Next(uint8_t* tag, const char** data, size_t* len){
+        if(left <= 0 || end - p < 1)return false;
+        *tag = (uint8_t)*p++;
+        left--;
+        if(*tag == LogFormat::ARG_STR){
+            uint16_t n;
+            if(end - p < (ptrdiff_t)sizeof(n))return false;
+            memcpy(&n, p, sizeof(n));
+            p += sizeof(n);
+            if(end - p < n)return false;
+            *data = p;
+            *len = n;
+            p += n;
+            return true;
+        }
+        if(end - p < 8)return false;
+        *data = p;
+        *len = 8;
+        p += 8;
+        return true;
+    }
+};
+
+bool IsConversion(char c){
+    return strchr("diouxXeEfFgGaAcspn", c) != nullptr;
+}
+}
+
+//printf的子集：逐个转换说明取一个参数，去掉长度修饰后按参数实际存放的类型重新格式化
+size_t LogFormat::FormatArgs(const char* fmt, const char* args, size_t len, int argNum,
+                             char* out, size_t size){
+    if(size == 0)return 0;
+    ArgReader reader = {args, args + len, argNum};
+    size_t n = 0;
+    const char* f = fmt;
+    while(*f && n + 1 < size){
+        if(*f != '%'){
+            out[n++] = *f++;
+            continue;
+        }
+        if(f[1] == '%'){
+            out[n++] = '%';
+            f += 2;
+            continue;
+        }
+        //spec为去掉长度修饰的转换说明，*宽度和精度替换为参数的值
+        char spec[64];
+        size_t s = 0;
+        spec[s++] = *f++;
+        while(*f && !IsConversion(*f) && s < sizeof(spec) - 24){
+            if(*f == '*'){
+                uint8_t tag;
+                const char* data;
+                size_t dataLen;
+                int64_t v = 0;
+                if(reader.Next(&tag, &data, &dataLen) && (tag == ARG_INT || tag == ARG_UINT)){
+                    memcpy(&v, data, sizeof(v));
+                }
+                s += snprintf(spec + s, sizeof(spec) - s, "%d", (int)v);
+            }else if(!strchr("hlLqjzt", *f)){
+                spec[s++] = *f;
+            }
+            f++;
+        }
+        if(!*f)break;
+        char conv = *f++;
+
+        uint8_t tag;
+        const char* data;
+        size_t dataLen;
+        int w;
+        if(conv == 'n')continue;
+        if(!reader.Next(&tag, &data, &dataLen)){
+            w = snprintf(out + n, size - n, "<?>");
+        }else if(tag == ARG_STR){
+            if(memchr(spec, '.', s)){
+                //带精度时先补上结尾的0
+                char str[4096];
+                size_t m = dataLen < sizeof(str) - 1 ? dataLen : sizeof(str) - 1;
+                memcpy(str, data, m);
+                str[m] = '\0';
+                spec[s++] = 's';
+                spec[s] = '\0';
+                w = snprintf(out + n, size - n, spec, str);
+            }else{
+                memcpy(spec + s, ".*s", 4);
+                w = snprintf(out + n, size - n, spec, (int)dataLen, data);
+            }
+        }else if(tag == ARG_DOUBLE){
+            double v;
+            memcpy(&v, data, sizeof(v));
+            spec[s++] = strchr("eEfFgGaA", conv) ? conv : 'g';
+            spec[s] = '\0';
+            w = snprintf(out + n, size - n, spec, v);
+        }else if(tag == ARG_PTR){
+            uint64_t v;
+            memcpy(&v, data, sizeof(v));
+            spec[s++] = 'p';
+            spec[s] = '\0';
+            w = snprintf(out + n, size - n, spec, (void*)(uintptr_t)v);
+        }else{
+            int64_t v;
+            memcpy(&v, data, sizeof(v));
+            if(conv == 'c'){
+                spec[s++] = 'c';
+                spec[s] = '\0';
+                w = snprintf(out + n, size - n, spec, (int)v);
+            }else{
+                //整数一律按long long输出，转换字符不是整数的按d/u处理
+                spec[s++] = 'l';
+                spec[s++] = 'l';
+                spec[s++] = strchr("diouxX", conv) ? conv : (tag == ARG_INT ? 'd' : 'u');
+                spec[s] = '\0';
+                w = snprintf(out + n, size - n, spec, (long long)v);
+            }
+        }
+        if(w > 0)n += (size_t)w < size - n ? w : size - n - 1;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+size_t LogFormat::FormatLine(const LogRecordHeader& header, const char* fmt, const char* record,
+                             int64_t realBase, int64_t monoBase, StampCache& stamp, char* out, size_t size){
+    int64_t real = realBase + (header.ts - monoBase);
+    time_t sec = (time_t)(real / 1000000000);
+    long usec = (long)(real % 1000000000 / 1000);
+    if(sec != stamp.sec){
+        struct tm t;
+        localtime_r(&sec, &t);
+        stamp.len = snprintf(stamp.text, sizeof(stamp.text), "%d-%02d-%02d %02d:%02d:%02d.",
+            t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+        stamp.sec = sec;
+    }
+    //时间(26) + 级别(9) + 换行，out至少要能放下这些
+    size_t n = stamp.len;
+    memcpy(out, stamp.text, n);
+    n += snprintf(out + n, size - n, "%06ld", usec);
+    memcpy(out + n, LevelTitle(header.level), 9);
+    n += 9;
+    const char* body = record + sizeof(LogRecordHeader);
+    n += FormatArgs(fmt, body, header.size - sizeof(LogRecordHeader), header.argNum, out + n, size - n - 1);
+    out[n++] = '\n';
+    return n;
+}
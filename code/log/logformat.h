@@ -0,0 +1,105 @@
+#ifndef LOG_FORMAT_H
+#define LOG_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <type_traits>
+
+//延迟格式化的日志记录：热路径只写格式编号、单调时钟时间戳和二进制参数，
+//由日志写线程或离线工具(bin/logdecode)按格式串还原成文本。
+//记录 = 头部 + 参数，每个参数一个类型字节加数据，整数按64位存放
+struct LogRecordHeader{
+    uint32_t size;          //整条记录的字节数，含头部
+    uint16_t fmtId;
+    uint8_t level;
+    uint8_t argNum;
+    int64_t ts;             //CLOCK_MONOTONIC纳秒
+};
+
+class LogFormat{
+public:
+    enum ARG_TAG{
+        ARG_INT = 1,
+        ARG_UINT,
+        ARG_DOUBLE,
+        ARG_STR,            //uint16长度 + 内容，不含结尾的0
+        ARG_PTR,
+    };
+
+    //二进制日志文件里的特殊记录，fmtId取这两个值
+    static const uint16_t CLOCK_ID = 0xFFFF;        //参数为实时时钟和单调时钟的一对纳秒值
+    static const uint16_t FORMAT_DEF_ID = 0xFFFE;   //参数为格式编号和格式串，在文件里第一次用到前写入
+    static const uint16_t MAX_FORMAT_ID = 0xFFFD;
+
+    struct StampCache{      //一秒内只做一次localtime
+        time_t sec;
+        char text[80];
+        size_t len;
+        StampCache():sec(-1), len(0){ text[0] = '\0'; }
+    };
+
+    static const char* LevelTitle(int level);      //都是9个字符
+
+    //把记录编码到buf，返回记录长度；参数放不下时截断字符串，buf至少要能放下头部
+    template<typename... Args>
+    static size_t Encode(char* buf, size_t size, int fmtId, int level, int64_t ts, Args... args){
+        LogRecordHeader header;
+        header.fmtId = (uint16_t)fmtId;
+        header.level = (uint8_t)level;
+        header.argNum = (uint8_t)sizeof...(Args);
+        header.ts = ts;
+        char* p = buf + sizeof(header);
+        char* end = buf + size;
+        EncodeArgs_(p, end, args...);
+        header.size = (uint32_t)(p - buf);
+        memcpy(buf, &header, sizeof(header));
+        return header.size;
+    }
+
+    //按格式串和二进制参数生成消息，返回写入out的长度(不含结尾的0)
+    static size_t FormatArgs(const char* fmt, const char* args, size_t len, int argNum,
+                             char* out, size_t size);
+    //把一条记录生成一整行：时间、级别和消息，以换行结尾；realBase/monoBase为同一时刻的两种时钟
+    static size_t FormatLine(const LogRecordHeader& header, const char* fmt, const char* record,
+                             int64_t realBase, int64_t monoBase, StampCache& stamp, char* out, size_t size);
+
+private:
+    static void EncodeArgs_(char*&, char*){}
+    template<typename T, typename... Rest>
+    static void EncodeArgs_(char*& p, char* end, T arg, Rest... rest){
+        EncodeArg_(p, end, arg);
+        EncodeArgs_(p, end, rest...);
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+    EncodeArg_(char*& p, char* end, T arg){
+        if(std::is_signed<T>::value || std::is_enum<T>::value){
+            Put_(p, end, ARG_INT, (int64_t)arg);
+        }else{
+            Put_(p, end, ARG_UINT, (uint64_t)arg);
+        }
+    }
+    template<typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type
+    EncodeArg_(char*& p, char* end, T arg){
+        Put_(p, end, ARG_DOUBLE, (double)arg);
+    }
+    static void EncodeArg_(char*& p, char* end, const char* arg);
+    static void EncodeArg_(char*& p, char* end, char* arg){ EncodeArg_(p, end, (const char*)arg); }
+    static void EncodeArg_(char*& p, char* end, const void* arg){ Put_(p, end, ARG_PTR, (uint64_t)(uintptr_t)arg); }
+    template<typename T>
+    static void EncodeArg_(char*& p, char* end, T* arg){ EncodeArg_(p, end, (const void*)arg); }
+
+    template<typename V>
+    static void Put_(char*& p, char* end, uint8_t tag, V value){
+        if(end - p < (ptrdiff_t)(1 + sizeof(value)))return;
+        *p++ = tag;
+        memcpy(p, &value, sizeof(value));
+        p += sizeof(value);
+    }
+};
+
+#endif
@@ -3,10 +3,54 @@
 
 int main(){
 
-    WebServer server(
-        15538, 3, 60000, false,
-        3306, "lx", "luo0509x?", "wsdb",
-        12, 6, true, 1, 1024
-    );
+    ServerConfig config;
+    config.port = 15538;
+    config.trigMode = 3;
+    config.timeoutMs = 60000;
+    config.optLinger = false;
+
+    config.sqlPort = 3306;
+    config.sqlUser = "lx";
+    config.sqlPwd = "luo0509x?";
+    config.dbName = "wsdb";
+    config.connPoolNum = 12;
+    config.sqlConnMax = 24;
+    config.sqlWaitMs = 3000;
+    config.threadNum = 6;
+
+    config.openLog = true;
+    config.logLevel = 1;
+    config.logQueSize = 1024;
+    config.logFormat = Log::DEFERRED;
+
+    config.reactorNum = 0;
+    config.dispatchMode = 0;
+    config.backlog = 1024;
+    config.connAffinity = false;
+
+    config.sendMode = HttpResponse::SENDFILE;
+    config.fileCacheNum = 1024;
+    config.respCacheSize = 4 * 1024 * 1024;
+    config.maxBodySize = 1024 * 1024;
+    config.bodySpillSize = 64 * 1024;
+    config.autoIndex = false;
+    config.hashETag = false;
+    config.gzipStatic = true;
+    config.gzipCacheSize = 16 * 1024 * 1024;
+
+    config.headerTimeoutMs = 20000;
+    config.bodyTimeoutMs = 30000;
+    config.writeTimeoutMs = 30000;
+    config.timerSlackMs = 10;
+
+    config.authCacheNum = 10000;
+    config.authCacheTtlMs = 60000;
+    config.regBatchSize = 64;
+    config.regBatchWaitUs = 1000;
+
+    WebServer server(config);
+    server.SetCacheControl("/", "no-cache");
+    server.SetCacheControl("/video/", "public, max-age=86400");
+    server.SetCacheControl("/images/", "public, max-age=86400");
     server.Start();
-}
\ No newline at end of file
+}
@@ -0,0 +1,80 @@
+#include "dbexecutor.h"
+
+using namespace std;
+
+DbExecutor* DbExecutor::Instance(){
+    static DbExecutor executor;
+    return &executor;
+}
+
+DbExecutor::DbExecutor():maxPending_(0), isOpen_(false){}
+
+DbExecutor::~DbExecutor(){
+    Close();
+}
+
+void DbExecutor::Init(int threadNum, size_t maxPending){
+    assert(threadNum > 0);
+    Close();
+    maxPending_ = maxPending;
+    isOpen_ = true;
+    for(int i = 0; i < threadNum; i++){
+        threads_.emplace_back(&DbExecutor::Run_, this);
+    }
+    LOG_INFO("DbExecutor threads: %d, max pending: %d", threadNum, (int)maxPending);
+}
+
+void DbExecutor::Close(){
+    {
+        lock_guard<mutex> locker(mtx_);
+        if(!isOpen_ && threads_.empty())return;
+        isOpen_ = false;
+        if(!jobs_.empty()){
+            LOG_WARN("DbExecutor drop %d pending jobs", (int)jobs_.size());
+            jobs_.clear();
+        }
+    }
+    cond_.notify_all();
+    for(auto& t: threads_){
+        if(t.joinable())t.join();
+    }
+    threads_.clear();
+}
+
+bool DbExecutor::Submit(function<void()> job){
+    assert(job);
+    {
+        lock_guard<mutex> locker(mtx_);
+        if(!isOpen_)return false;
+        if(jobs_.size() >= maxPending_){
+            //数据库跟不上，与其无限排队不如让请求直接失败
+            LOG_WARN("DbExecutor busy, %d jobs pending", (int)jobs_.size());
+            return false;
+        }
+        jobs_.push_back(std::move(job));
+    }
+    cond_.notify_one();
+    return true;
+}
+
+size_t DbExecutor::Pending(){
+    lock_guard<mutex> locker(mtx_);
+    return jobs_.size();
+}
+
+void DbExecutor::Run_(){
+    unique_lock<mutex> locker(mtx_);
+    while(true){
+        if(!jobs_.empty()){
+            function<void()> job = std::move(jobs_.front());
+            jobs_.pop_front();
+            locker.unlock();
+            job();
+            locker.lock();
+        }else if(!isOpen_){
+            break;
+        }else{
+            cond_.wait(locker);
+        }
+    }
+}
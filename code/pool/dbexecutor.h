@@ -0,0 +1,43 @@
+#ifndef DB_EXECUTOR_H
+#define DB_EXECUTOR_H
+
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <assert.h>
+
+#include "../log/log.h"
+
+//数据库执行器：登录、注册这类阻塞的数据库操作放到专用线程上执行，工作线程和从reactor
+//不再为一次数据库往返停住，数据库变慢时静态文件照常服务。
+//任务执行完后由任务自己把结果投递回连接所在的事件循环
+class DbExecutor{
+public:
+    static DbExecutor* Instance();
+
+    //threadNum一般等于数据库连接数，maxPending为排队任务上限
+    void Init(int threadNum, size_t maxPending = 4096);
+    void Close();       //不再接收任务，丢弃还没开始执行的，等正在执行的完成
+    bool IsOpen() const { return isOpen_; }
+
+    bool Submit(std::function<void()> job);     //未启动或排队已满时返回false
+    size_t Pending();
+
+private:
+    DbExecutor();
+    ~DbExecutor();
+    void Run_();
+
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    std::deque<std::function<void()>> jobs_;
+    std::vector<std::thread> threads_;
+    size_t maxPending_;
+    std::atomic<bool> isOpen_;
+};
+
+#endif
@@ -1,68 +1,272 @@
 #include "sqlconnpool.h"
 
+using namespace std;
+
+const int SqlConnPool::PING_IDLE_MS;
+const int SqlConnPool::SHRINK_IDLE_MS;
+const int SqlConnPool::RETRY_MS;
+
 SqlConnPool* SqlConnPool::Instance(){
     static SqlConnPool pool;
     return &pool;
 }
 
-void SqlConnPool::Init(const char* host, int port, const char* user, 
-        const char* pwd, const char* dbName, int connSize = 10){
+SqlConnPool::SqlConnPool():port_(0), minConn_(0), maxConn_(0), waitTimeoutMs_(-1), isOpen_(false),
+    connCount_(0), gets_(0), waits_(0), waitUs_(0), timeouts_(0), reconnects_(0){}
+
+void SqlConnPool::Init(const char* host, int port, const char* user,
+        const char* pwd, const char* dbName, int connSize, int maxConn, int waitTimeoutMs){
     assert(connSize > 0);
-    for(int i = 0; i < connSize; i++){
-        //连接数据库的标准操作
-        MYSQL* conn = nullptr;
-        conn = mysql_init(conn);
-        if(!conn){
-            LOG_ERROR("Mysql init error!");
-            assert(conn);
-        }
-        conn = mysql_real_connect(conn, host, user, pwd, dbName, port, nullptr, 0);
+    host_ = host;
+    port_ = port;
+    user_ = user;
+    pwd_ = pwd;
+    dbName_ = dbName;
+    minConn_ = connSize;
+    maxConn_ = maxConn > connSize ? maxConn : connSize;
+    waitTimeoutMs_ = waitTimeoutMs;
+    retryAt_ = Clock::now();
+    isOpen_ = true;
+    for(int i = 0; i < minConn_; i++){
+        MYSQL* conn = Connect_();
         if(!conn){
-            LOG_ERROR("Mysql Connect error");
+            //连不上的不再放nullptr占位，借出时按需补建
+            retryAt_ = Clock::now() + chrono::milliseconds(RETRY_MS);
+            break;
         }
-        connQue_.push(conn);
+        lock_guard<mutex>locker(mtx_);
+        info_[conn].lastUsed = Clock::now();
+        idle_.push_back(conn);
+        connCount_++;
     }
-    MAX_CONN_ = connSize;
-    //pshared = 0 表示该信号量不可共享
-    sem_init(&semID_, 0, MAX_CONN_);
+}
 
+MYSQL* SqlConnPool::Connect_(){
+    //连接数据库的标准操作
+    MYSQL* conn = mysql_init(nullptr);
+    if(!conn){
+        LOG_ERROR("Mysql init error!");
+        return nullptr;
+    }
+    unsigned int timeout = 3;
+    mysql_options(conn, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+    if(!mysql_real_connect(conn, host_.c_str(), user_.c_str(), pwd_.c_str(), dbName_.c_str(),
+                           port_, nullptr, 0)){
+        LOG_ERROR("Mysql Connect error: %s", mysql_error(conn));
+        mysql_close(conn);
+        return nullptr;
+    }
+    return conn;
 }
 
 MYSQL* SqlConnPool::GetConn(){
+    return GetConn(waitTimeoutMs_);
+}
+
+MYSQL* SqlConnPool::GetConn(int timeoutMs){
+    gets_++;
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+    bool waited = false;
     MYSQL* conn = nullptr;
-    if(connQue_.empty()){
-        LOG_WARN("SqlConnPool busy!");
-        return nullptr;
+    unique_lock<mutex>locker(mtx_);
+    while(isOpen_){
+        if(!idle_.empty()){
+            conn = idle_.back();
+            idle_.pop_back();
+            ConnInfo& info = info_[conn];
+            //刚用过的直接借出；空闲太久或出过错的先ping一次，服务端可能已经把它断开了
+            if(!info.suspect && Clock::now() - info.lastUsed < chrono::milliseconds(PING_IDLE_MS))break;
+            //ping要一次往返，不持锁；conn已经从空闲表摘下，其他线程拿不到
+            locker.unlock();
+            bool ok = mysql_ping(conn) == 0;
+            locker.lock();
+            if(ok){
+                info_[conn].suspect = false;
+                break;
+            }
+            LOG_WARN("SqlConnPool drop broken connection");
+            ConnInfo broken = std::move(info_[conn]);
+            info_.erase(conn);
+            connCount_--;
+            reconnects_++;
+            locker.unlock();
+            CloseStmts_(broken);
+            mysql_close(conn);
+            conn = nullptr;
+            locker.lock();
+            continue;       //下面按需重建
+        }
+        Clock::time_point now = Clock::now();
+        if(connCount_ < maxConn_ && now >= retryAt_){
+            //先占一个名额再去连，连接期间其他线程不会超出上限
+            connCount_++;
+            locker.unlock();
+            conn = Connect_();
+            locker.lock();
+            if(conn){
+                info_[conn].lastUsed = Clock::now();
+                break;
+            }
+            connCount_--;
+            retryAt_ = Clock::now() + chrono::milliseconds(RETRY_MS);
+            continue;
+        }
+        if(!waited){
+            waited = true;
+            waits_++;
+            LOG_WARN("SqlConnPool busy!");
+        }
+        if(timeoutMs >= 0 && now >= deadline){
+            timeouts_++;
+            break;
+        }
+        //还能新建连接时最多等到允许重试的时刻
+        Clock::time_point until = timeoutMs < 0 ? Clock::time_point::max() : deadline;
+        if(connCount_ < maxConn_ && retryAt_ < until)until = retryAt_;
+        if(until == Clock::time_point::max()){
+            cond_.wait(locker);
+        }else{
+            cond_.wait_until(locker, until);
+        }
     }
-    sem_wait(&semID_);
-    {
-        lock_guard<mutex>locker(mtx_);
-        conn = connQue_.front();
-        connQue_.pop();
+    locker.unlock();
+    if(waited){
+        waitUs_ += chrono::duration_cast<chrono::microseconds>(Clock::now() - start).count();
     }
+    if(!conn && isOpen_)LOG_ERROR("SqlConnPool get connection timeout!");
     return conn;
 }
 
 //存入连接池
 void SqlConnPool::FreeConn(MYSQL* sql){
     assert(sql);
-    lock_guard<mutex>locker(mtx_);
-    connQue_.push(sql);
-    sem_post(&semID_);
+    vector<pair<MYSQL*, ConnInfo>> closing;
+    {
+        lock_guard<mutex>locker(mtx_);
+        auto it = info_.find(sql);
+        assert(it != info_.end());
+        if(!isOpen_){
+            closing.emplace_back(sql, std::move(it->second));
+            info_.erase(it);
+            connCount_--;
+        }else{
+            it->second.lastUsed = Clock::now();
+            idle_.push_back(sql);
+            Shrink_(closing);
+        }
+    }
+    cond_.notify_one();
+    for(auto& item: closing){
+        CloseStmts_(item.second);
+        mysql_close(item.first);
+    }
+}
+
+//空闲表头是最久没用的连接，超过minConn_的部分空闲太久就关掉
+void SqlConnPool::Shrink_(vector<pair<MYSQL*, ConnInfo>>& closing){
+    Clock::time_point now = Clock::now();
+    while(connCount_ > minConn_ && !idle_.empty()){
+        MYSQL* conn = idle_.front();
+        auto it = info_.find(conn);
+        if(now - it->second.lastUsed < chrono::milliseconds(SHRINK_IDLE_MS))break;
+        idle_.pop_front();
+        closing.emplace_back(conn, std::move(it->second));
+        info_.erase(it);
+        connCount_--;
+    }
 }
 
 void SqlConnPool::ClosePool(){
-    lock_guard<mutex>locker(mtx_);
-    while(!connQue_.empty()){
-        auto conn = connQue_.front();
-        connQue_.pop();
-        mysql_close(conn);
+    vector<pair<MYSQL*, ConnInfo>> closing;
+    {
+        lock_guard<mutex>locker(mtx_);
+        if(isOpen_){
+            Stats stats = GetStats_();
+            LOG_INFO("SqlConnPool gets: %llu, waits: %llu, avg wait: %lluus, timeouts: %llu, reconnects: %llu",
+                (unsigned long long)stats.gets, (unsigned long long)stats.waits,
+                (unsigned long long)(stats.waits ? stats.waitUs / stats.waits : 0),
+                (unsigned long long)stats.timeouts, (unsigned long long)stats.reconnects);
+        }
+        isOpen_ = false;
+        //借出中的连接在归还时关闭
+        while(!idle_.empty()){
+            MYSQL* conn = idle_.front();
+            idle_.pop_front();
+            closing.emplace_back(conn, std::move(info_[conn]));
+            info_.erase(conn);
+            connCount_--;
+        }
+    }
+    cond_.notify_all();
+    for(auto& item: closing){
+        CloseStmts_(item.second);
+        mysql_close(item.first);
     }
     mysql_library_end();
 }
 
 int SqlConnPool::GetFreeConnCount(){
     lock_guard<mutex>locker(mtx_);
-    return connQue_.size();
+    return idle_.size();
 }
 
+SqlConnPool::Stats SqlConnPool::GetStats(){
+    lock_guard<mutex>locker(mtx_);
+    return GetStats_();
+}
+
+SqlConnPool::Stats SqlConnPool::GetStats_(){
+    Stats stats;
+    stats.connCount = connCount_;
+    stats.busyCount = connCount_ - (int)idle_.size();
+    stats.gets = gets_;
+    stats.waits = waits_;
+    stats.waitUs = waitUs_;
+    stats.timeouts = timeouts_;
+    stats.reconnects = reconnects_;
+    return stats;
+}
+
+
+MYSQL_STMT* SqlConnPool::GetStmt(MYSQL* conn, const char* sql){
+    assert(conn && sql);
+    {
+        lock_guard<mutex>locker(mtx_);
+        auto& stmts = info_[conn].stmts;
+        auto it = stmts.find(sql);
+        if(it != stmts.end())return it->second;
+    }
+    //prepare要一次往返，不持锁；conn只有当前线程在用，不会重复prepare
+    MYSQL_STMT* stmt = mysql_stmt_init(conn);
+    if(!stmt){
+        LOG_ERROR("Mysql stmt init error!");
+        return nullptr;
+    }
+    if(mysql_stmt_prepare(stmt, sql, strlen(sql))){
+        LOG_ERROR("Mysql prepare error: %s", mysql_stmt_error(stmt));
+        mysql_stmt_close(stmt);
+        return nullptr;
+    }
+    lock_guard<mutex>locker(mtx_);
+    info_[conn].stmts[sql] = stmt;
+    return stmt;
+}
+
+void SqlConnPool::ResetStmts(MYSQL* conn){
+    ConnInfo old;
+    {
+        lock_guard<mutex>locker(mtx_);
+        ConnInfo& info = info_[conn];
+        old.stmts.swap(info.stmts);
+        info.suspect = true;
+    }
+    CloseStmts_(old);
+}
+
+void SqlConnPool::CloseStmts_(ConnInfo& info){
+    for(auto& stmt: info.stmts){
+        mysql_stmt_close(stmt.second);
+    }
+    info.stmts.clear();
+}
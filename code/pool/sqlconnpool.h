@@ -3,31 +3,86 @@
 
 #include<mysql/mysql.h>
 #include<string>
-#include<queue>
+#include<deque>
+#include<vector>
+#include<utility>
 #include<mutex>
-#include<semaphore.h>
+#include<condition_variable>
+#include<chrono>
+#include<atomic>
 #include<thread>
+#include<unordered_map>
 #include"../log/log.h"
 
+//弹性数据库连接池：连接数在minConn和maxConn之间随负载增减，借出前检查连接是否可用，
+//断开的连接透明地重连；没有空闲连接时等待，超过期限返回nullptr而不是无限阻塞
 class SqlConnPool{
 public:
     static SqlConnPool *Instance();
-    MYSQL *GetConn();
+    MYSQL *GetConn();                   //等待Init设置的期限
+    MYSQL *GetConn(int timeoutMs);      //timeoutMs<0时一直等
     void FreeConn(MYSQL *Conn);
     int GetFreeConnCount();
 
+    //connSize为常驻的连接数，maxConn为上限(不大于connSize时固定为connSize)
     void Init(const char* host, int port, const char* user, 
-    const char* pwd, const char* dbName, int connSize);
+    const char* pwd, const char* dbName, int connSize, int maxConn = 0, int waitTimeoutMs = 3000);
     void ClosePool();
 
+    //conn上预处理好的sql语句，第一次用时prepare，之后一直复用；调用方必须持有conn
+    MYSQL_STMT* GetStmt(MYSQL* conn, const char* sql);
+    //语句执行出错(如连接断开)后丢掉conn上的所有语句，下次重新prepare，下次借出前先ping
+    void ResetStmts(MYSQL* conn);
+
+    struct Stats{
+        int connCount;          //已建立的连接数
+        int busyCount;          //借出中的连接数
+        uint64_t gets;          //借出次数
+        uint64_t waits;         //需要等待的次数
+        uint64_t waitUs;        //累计等待时间
+        uint64_t timeouts;      //等待超时次数
+        uint64_t reconnects;    //检查不通过后重连的次数
+    };
+    Stats GetStats();
+
 private:
-    SqlConnPool() = default;
+    SqlConnPool();
     ~SqlConnPool(){ClosePool();}
-    int MAX_CONN_;
 
-    std::queue<MYSQL *>connQue_;
+    typedef std::chrono::steady_clock Clock;
+
+    struct ConnInfo{
+        std::unordered_map<std::string, MYSQL_STMT*>stmts;
+        Clock::time_point lastUsed;
+        bool suspect;           //执行出过错，借出前要ping
+        ConnInfo():suspect(false){}
+    };
+
+    MYSQL* Connect_();
+    //持锁调用，把空闲太久的多余连接摘下放进closing，由调用方在锁外关闭
+    void Shrink_(std::vector<std::pair<MYSQL*, ConnInfo>>& closing);
+    Stats GetStats_();
+    void CloseStmts_(ConnInfo& info);
+
+    static const int PING_IDLE_MS = 5000;       //空闲超过这个时间的连接借出前先ping
+    static const int SHRINK_IDLE_MS = 60000;    //超过minConn的连接空闲这么久后关闭
+    static const int RETRY_MS = 1000;           //连接失败后的重试间隔
+
+    std::string host_, user_, pwd_, dbName_;
+    int port_;
+    int minConn_;
+    int maxConn_;
+    int waitTimeoutMs_;
+    bool isOpen_;
+
+    int connCount_;                 //已建立和正在建立的连接数
+    std::deque<MYSQL*>idle_;        //表尾为最近归还的，借出时从表尾取，收缩时从表头关
+    std::unordered_map<MYSQL*, ConnInfo>info_;
+    Clock::time_point retryAt_;     //在此之前不再尝试新建连接
     std::mutex mtx_;
-    sem_t semID_;
+    std::condition_variable cond_;
+
+    std::atomic<uint64_t> gets_, waits_, waitUs_, timeouts_, reconnects_;
 };
 
 class SqlConnRAII{
@@ -49,4 +104,4 @@ private:
 };
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,288 @@
+#include "threadpool.h"
+
+using namespace std;
+
+TaskQueue::TaskQueue(size_t capacity):enqueuePos_(0), dequeuePos_(0){
+    size_t size = 2;
+    while(size < capacity)size <<= 1;
+    cells_.reset(new Cell[size]);
+    mask_ = size - 1;
+    for(size_t i = 0; i < size; i++){
+        cells_[i].seq.store(i, memory_order_relaxed);
+    }
+}
+
+bool TaskQueue::Push(Task& task){
+    size_t pos = enqueuePos_.load(memory_order_relaxed);
+    while(true){
+        Cell& cell = cells_[pos & mask_];
+        size_t seq = cell.seq.load(memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if(diff == 0){
+            //槽是空的，抢到这个位置就可以写
+            if(enqueuePos_.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)){
+                cell.task = std::move(task);
+                cell.seq.store(pos + 1, memory_order_release);
+                return true;
+            }
+        }else if(diff < 0){
+            return false;   //一整圈前的任务还没被取走，队列满
+        }else{
+            pos = enqueuePos_.load(memory_order_relaxed);
+        }
+    }
+}
+
+bool TaskQueue::Pop(Task& task){
+    size_t pos = dequeuePos_.load(memory_order_relaxed);
+    while(true){
+        Cell& cell = cells_[pos & mask_];
+        size_t seq = cell.seq.load(memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if(diff == 0){
+            if(dequeuePos_.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)){
+                task = std::move(cell.task);
+                //留给下一圈的生产者
+                cell.seq.store(pos + mask_ + 1, memory_order_release);
+                return true;
+            }
+        }else if(diff < 0){
+            return false;   //队列空
+        }else{
+            pos = dequeuePos_.load(memory_order_relaxed);
+        }
+    }
+}
+
+bool TaskQueue::Empty() const{
+    size_t pos = dequeuePos_.load(memory_order_acquire);
+    return cells_[pos & mask_].seq.load(memory_order_acquire) != pos + 1;
+}
+
+size_t TaskQueue::Size() const{
+    size_t tail = dequeuePos_.load(memory_order_relaxed);
+    size_t head = enqueuePos_.load(memory_order_relaxed);
+    return head > tail ? head - tail : 0;
+}
+
+thread_local ThreadPool* ThreadPool::curPool_ = nullptr;
+thread_local int ThreadPool::curId_ = -1;
+
+ThreadPool::ThreadPool(int threadCount):inject_(INJECT_SIZE), overflowSize_(0),
+    spinning_(0), sleeping_(0), nextWake_(0), isClosed_(false), isPinned_(false){
+    assert(threadCount > 0);
+    for(int i = 0; i < threadCount; i++){
+        workers_.emplace_back(new Worker());
+    }
+    //所有队列建好之后再启动线程，偷任务时会访问其他线程的队列
+    for(int i = 0; i < threadCount; i++){
+        workers_[i]->thread = thread(&ThreadPool::Run_, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    Close();
+}
+
+void ThreadPool::Close(){
+    isClosed_ = true;
+    for(auto& worker: workers_){
+        {
+            //加锁保证不会落在线程检查isClosed_和开始等待之间
+            lock_guard<mutex> locker(worker->mtx);
+            worker->epoch++;
+        }
+        worker->cond.notify_one();
+    }
+    for(auto& worker: workers_){
+        if(worker->thread.joinable())worker->thread.join();
+    }
+}
+
+void ThreadPool::SetCpuAffinity(const vector<int>& cpus){
+    if(cpus.empty())return;
+    bool pinned = true;
+    for(size_t i = 0; i < workers_.size(); i++){
+        int cpu = cpus[i % cpus.size()];
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if(pthread_setaffinity_np(workers_[i]->thread.native_handle(), sizeof(set), &set) != 0){
+            pinned = false;
+        }
+    }
+    isPinned_ = pinned;
+}
+
+void ThreadPool::Submit_(Task&& task){
+    assert(task);
+    if(curPool_ == this && workers_[curId_]->local.Push(task)){
+        //工作线程内提交的任务放进自己的本地队列，空闲的线程会来偷
+    }else if(!inject_.Push(task)){
+        lock_guard<mutex> locker(overflowMtx_);
+        overflow_.push_back(std::move(task));
+        overflowSize_.fetch_add(1, memory_order_release);
+    }
+    Wake_();
+}
+
+void ThreadPool::SubmitTo_(int id, Task&& task){
+    assert(task);
+    Worker& worker = *workers_[id];
+    if(!worker.affine.Push(task)){
+        //指定的线程积压太多，先放进它的backlog，不交给其他线程
+        lock_guard<mutex> locker(worker.mtx);
+        worker.backlog.push_back(std::move(task));
+        worker.backlogSize.fetch_add(1, memory_order_release);
+    }
+    WakeWorker_(worker);
+}
+
+//有线程在自旋时它会自己找到任务；都在睡眠时才需要唤醒一个
+void ThreadPool::Wake_(){
+    //与Run_中登记睡眠后的fence配对：要么这里看到它在睡眠，要么它睡眠前能看到刚提交的任务
+    atomic_thread_fence(memory_order_seq_cst);
+    if(spinning_.load(memory_order_relaxed) > 0 || sleeping_.load(memory_order_relaxed) == 0)return;
+    size_t n = workers_.size();
+    size_t start = nextWake_.fetch_add(1, memory_order_relaxed);
+    for(size_t i = 0; i < n; i++){
+        Worker& worker = *workers_[(start + i) % n];
+        if(worker.sleeping.load(memory_order_relaxed)){
+            WakeWorker_(worker);
+            return;
+        }
+    }
+}
+
+void ThreadPool::WakeWorker_(Worker& worker){
+    atomic_thread_fence(memory_order_seq_cst);
+    //没在睡眠的线程取完手上的任务后会自己检查队列
+    if(!worker.sleeping.load(memory_order_relaxed))return;
+    {
+        lock_guard<mutex> locker(worker.mtx);
+        worker.epoch++;
+    }
+    worker.cond.notify_one();
+}
+
+bool ThreadPool::Pop_(int id, Task& task){
+    Worker& self = *workers_[id];
+    if(self.affine.Pop(task))return true;
+    if(self.backlogSize.load(memory_order_acquire) > 0){
+        lock_guard<mutex> locker(self.mtx);
+        if(!self.backlog.empty()){
+            task = std::move(self.backlog.front());
+            self.backlog.pop_front();
+            self.backlogSize.fetch_sub(1, memory_order_relaxed);
+            return true;
+        }
+    }
+    if(self.local.Pop(task))return true;
+    if(inject_.Pop(task)){
+        //多取几个放进本地队列，减少在注入队列上的竞争；放不下就留在注入队列
+        for(int i = 1; i < BATCH_SIZE && workers_.size() > 1; i++){
+            Task extra;
+            if(!inject_.Pop(extra))break;
+            if(!self.local.Push(extra)){
+                if(!inject_.Push(extra)){
+                    lock_guard<mutex> locker(overflowMtx_);
+                    overflow_.push_back(std::move(extra));
+                    overflowSize_.fetch_add(1, memory_order_release);
+                }
+                break;
+            }
+        }
+        return true;
+    }
+    if(overflowSize_.load(memory_order_acquire) > 0){
+        lock_guard<mutex> locker(overflowMtx_);
+        if(!overflow_.empty()){
+            task = std::move(overflow_.front());
+            overflow_.pop_front();
+            overflowSize_.fetch_sub(1, memory_order_relaxed);
+            return true;
+        }
+    }
+    //从下一个线程开始轮流偷，避免所有空闲线程都挤在同一个队列上；指定线程的任务不偷
+    int n = (int)workers_.size();
+    for(int i = 1; i < n; i++){
+        if(workers_[(id + i) % n]->local.Pop(task))return true;
+    }
+    return false;
+}
+
+//id线程能取到的任务：共享的队列加上自己的指定队列
+bool ThreadPool::HasTask_(int id) const{
+    const Worker& self = *workers_[id];
+    if(!self.affine.Empty() || self.backlogSize.load(memory_order_acquire) > 0)return true;
+    if(!inject_.Empty() || overflowSize_.load(memory_order_acquire) > 0)return true;
+    for(auto& worker: workers_){
+        if(!worker->local.Empty())return true;
+    }
+    return false;
+}
+
+void ThreadPool::CpuRelax_(){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+void ThreadPool::Run_(int id){
+    curPool_ = this;
+    curId_ = id;
+    Worker& self = *workers_[id];
+    Task task;
+    int idle = 0;
+    while(true){
+        if(Pop_(id, task)){
+            if(idle > 0){
+                //自旋中找到了任务，不再算作自旋；如果是最后一个自旋的线程且还有剩余任务，
+                //叫醒一个睡眠的线程接着找，不然剩下的任务要等这个任务执行完
+                idle = 0;
+                if(spinning_.fetch_sub(1) == 1 && HasTask_(id))Wake_();
+            }
+            task();
+            task.Reset();
+            continue;
+        }
+        if(idle == 0){
+            spinning_.fetch_add(1, memory_order_acq_rel);
+        }
+        if(idle < SPIN_COUNT){
+            idle++;
+            CpuRelax_();
+            continue;
+        }
+        if(idle < SPIN_COUNT + YIELD_COUNT){
+            idle++;
+            this_thread::yield();
+            continue;
+        }
+
+        unique_lock<mutex> locker(self.mtx);
+        self.sleeping.store(true, memory_order_relaxed);
+        sleeping_.fetch_add(1, memory_order_relaxed);
+        spinning_.fetch_sub(1, memory_order_relaxed);
+        idle = 0;
+        atomic_thread_fence(memory_order_seq_cst);
+        bool hasTask = HasTask_(id);
+        if(hasTask || isClosed_){
+            self.sleeping.store(false, memory_order_relaxed);
+            sleeping_.fetch_sub(1, memory_order_relaxed);
+            if(hasTask)continue;
+            break;      //已关闭且所有任务都执行完了
+        }
+        uint64_t epoch = self.epoch;
+        self.cond.wait(locker, [&self, epoch]{ return self.epoch != epoch; });
+        self.sleeping.store(false, memory_order_relaxed);
+        sleeping_.fetch_sub(1, memory_order_relaxed);
+        //被唤醒后先算作自旋的线程，这样找到任务时还能接力唤醒下一个
+        spinning_.fetch_add(1, memory_order_acq_rel);
+        idle = 1;
+    }
+    curPool_ = nullptr;
+    curId_ = -1;
+}
@@ -1,68 +1,215 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
-#include<queue>
 #include<mutex>
 #include<condition_variable>
-#include<functional>
 #include<thread>
+#include<functional>
+#include<atomic>
+#include<memory>
+#include<vector>
+#include<deque>
+#include<new>
+#include<utility>
+#include<cstddef>
+#include<type_traits>
 #include<assert.h>
+#include<pthread.h>
+#include<sched.h>
 
-class ThreadPool{
+//小对象优化的任务：可调用对象不超过INLINE_SIZE时直接构造在Task内部，
+//bind(&WebServer::OnRead_, this, client)这类任务不分配堆内存；更大的才放到堆上
+class Task{
 public:
-    ThreadPool() = default;
-    ThreadPool(ThreadPool &&) = default;            //移动构造函数
-    // 尽量用make_shared代替new，如果通过new再传递给shared_ptr，内存是不连续的，会造成内存碎片化
-    explicit ThreadPool(int threadCount = 8):pool_(std::make_shared<Pool>()){
-        assert(threadCount > 0);
-        for(int i = 0; i < threadCount; i ++){
-            std::thread([this](){
-                std::unique_lock<std::mutex>locker(pool_->mtx_);
-                while(true){
-                    if(!pool_->tasks.empty()){
-                        auto task = std::move(pool_->tasks.front());//取出队头的任务,使用move将左值转化为右值，实现移动语意
-                        pool_->tasks.pop();
-                        locker.unlock();
-                        task();//开始执行
-                        locker.lock();
-                    }else if(pool_->isClosed){
-                        break;
-                    }else{
-                        pool_->cond_.wait(locker);//释放锁并使线程进入等待状态，直到有任务被添加到队列或线程池关闭。
-                    }
-                }
-            }).detach();//线程分离
+    static const size_t INLINE_SIZE = 48;
+
+    Task() noexcept : ops_(nullptr){}
+    template<typename F, typename D = typename std::decay<F>::type,
+             typename = typename std::enable_if<!std::is_same<D, Task>::value>::type>
+    Task(F&& f) : ops_(nullptr){
+        Init_<D>(std::forward<F>(f), std::integral_constant<bool, IsInline_<D>()>());
+    }
+    Task(Task&& other) noexcept : ops_(other.ops_){
+        if(ops_){
+            ops_->move(buf_, other.buf_);
+            other.ops_ = nullptr;
         }
     }
+    Task& operator=(Task&& other) noexcept{
+        if(this != &other){
+            Reset();
+            if(other.ops_){
+                other.ops_->move(buf_, other.buf_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task(){ Reset(); }
 
-    ~ThreadPool(){
-        if(pool_){
-            std::unique_lock<std::mutex>locker(pool_->mtx_);
-            pool_->isClosed = true;
-            pool_->cond_.notify_all();//唤醒所有线程
+    explicit operator bool() const { return ops_ != nullptr; }
+    void operator()(){ assert(ops_); ops_->call(buf_); }
+    void Reset(){
+        if(ops_){
+            ops_->destroy(buf_);
+            ops_ = nullptr;
         }
-        
     }
 
-    template<typename T>     //T&& :通用引用实现完美转发，即将参数以原始的类型（左值或右值）传递给其他函数
-    void AddTask(T&& task){
-        {
-            std::unique_lock<std::mutex> locker(pool_->mtx_);
-            pool_->tasks.emplace(std::forward<T>(task));
+private:
+    struct Ops{
+        void (*call)(void* buf);
+        void (*move)(void* dst, void* src);     //移动到dst并析构src
+        void (*destroy)(void* buf);
+    };
+
+    template<typename D>
+    static constexpr bool IsInline_(){
+        return sizeof(D) <= INLINE_SIZE && alignof(D) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<D>::value;
+    }
+
+    template<typename D>
+    struct InlineOps{
+        static void Call(void* buf){ (*static_cast<D*>(buf))(); }
+        static void Move(void* dst, void* src){
+            new(dst) D(std::move(*static_cast<D*>(src)));
+            static_cast<D*>(src)->~D();
         }
-        pool_->cond_.notify_one();
+        static void Destroy(void* buf){ static_cast<D*>(buf)->~D(); }
+        static const Ops ops;
+    };
+
+    template<typename D>
+    struct HeapOps{
+        static void Call(void* buf){ (**static_cast<D**>(buf))(); }
+        static void Move(void* dst, void* src){ *static_cast<D**>(dst) = *static_cast<D**>(src); }
+        static void Destroy(void* buf){ delete *static_cast<D**>(buf); }
+        static const Ops ops;
+    };
+
+    template<typename D, typename F>
+    void Init_(F&& f, std::true_type){
+        new(buf_) D(std::forward<F>(f));
+        ops_ = &InlineOps<D>::ops;
+    }
+    template<typename D, typename F>
+    void Init_(F&& f, std::false_type){
+        *reinterpret_cast<D**>(buf_) = new D(std::forward<F>(f));
+        ops_ = &HeapOps<D>::ops;
     }
 
+    alignas(std::max_align_t) char buf_[INLINE_SIZE];
+    const Ops* ops_;
+};
+
+template<typename D>
+const Task::Ops Task::InlineOps<D>::ops = {&Call, &Move, &Destroy};
+template<typename D>
+const Task::Ops Task::HeapOps<D>::ops = {&Call, &Move, &Destroy};
+
+//有界无锁多生产者多消费者队列(Vyukov)：每个槽带一个序号，生产者和消费者各自CAS一个位置，
+//互相之间只在同一个槽上同步。满了Push返回false，由调用方决定退路
+class TaskQueue{
+public:
+    explicit TaskQueue(size_t capacity);
+
+    bool Push(Task& task);      //成功时task被移走
+    bool Pop(Task& task);
+    bool Empty() const;
+    size_t Size() const;
 
 private:
-    struct Pool{
-        std::mutex mtx_;                            //互斥锁
-        std::condition_variable cond_;              //条件变量，用于进程间通信
-        bool isClosed;
-        std::queue<std::function<void()>>tasks;     //任务队列，函数类型为void()
+    struct Cell{
+        std::atomic<size_t> seq;
+        Task task;
     };
-    std::shared_ptr<Pool>pool_;
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    char pad0_[64];
+    std::atomic<size_t> enqueuePos_;    //生产者和消费者的位置分开放在不同的缓存行
+    char pad1_[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> dequeuePos_;
+    char pad2_[64 - sizeof(std::atomic<size_t>)];
 };
 
+//工作窃取线程池：外部线程提交的任务进无锁的注入队列，工作线程内提交的任务进自己的本地队列；
+//工作线程先取本地队列，再从注入队列批量取一些，都没有时去偷其他线程本地队列里的任务。
+//空闲时先自旋一会儿再睡眠，有线程在自旋时提交任务不需要唤醒，省掉futex系统调用。
+//带key提交的任务固定交给第key % n个线程，不会被偷，同一个连接的状态一直留在同一个核的缓存里
+class ThreadPool{
+public:
+    explicit ThreadPool(int threadCount = 8);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    template<typename T>
+    void AddTask(T&& task){
+        Submit_(Task(std::forward<T>(task)));
+    }
+    template<typename T>
+    void AddTask(int key, T&& task){
+        SubmitTo_(WorkerOf(key), Task(std::forward<T>(task)));
+    }
+
+    //第i个工作线程绑定到cpus[i % cpus.size()]
+    void SetCpuAffinity(const std::vector<int>& cpus);
+    bool IsPinned() const { return isPinned_; }
+    int WorkerOf(int key) const { return (unsigned)key % workers_.size(); }
+
+    //不再等待新任务，执行完已提交的任务后回收所有工作线程
+    void Close();
+    int ThreadCount() const { return (int)workers_.size(); }
+
+private:
+    struct Worker{
+        TaskQueue local;
+        TaskQueue affine;                   //指定给这个线程的任务，只有它自己取
+        std::thread thread;
+        std::mutex mtx;                     //睡眠、唤醒和backlog使用
+        std::condition_variable cond;
+        uint64_t epoch;                     //每次唤醒加一，睡眠的线程据此判断是否被唤醒
+        std::atomic<bool> sleeping;
+        std::deque<Task> backlog;           //affine满时的退路，仍然只由这个线程执行
+        std::atomic<size_t> backlogSize;
+        Worker():local(LOCAL_SIZE), affine(AFFINE_SIZE), epoch(0), sleeping(false), backlogSize(0){}
+    };
+
+    void Submit_(Task&& task);
+    void SubmitTo_(int id, Task&& task);
+    void Run_(int id);
+    bool Pop_(int id, Task& task);
+    bool HasTask_(int id) const;
+    void Wake_();
+    void WakeWorker_(Worker& worker);
+    static void CpuRelax_();
+
+    static const size_t INJECT_SIZE = 4096;
+    static const size_t LOCAL_SIZE = 256;
+    static const size_t AFFINE_SIZE = 1024;
+    static const int BATCH_SIZE = 4;        //从注入队列一次取走的任务数，多出的放进本地队列
+    static const int SPIN_COUNT = 128;      //睡眠前的自旋次数
+    static const int YIELD_COUNT = 4;
+
+    static thread_local ThreadPool* curPool_;   //当前线程所属的线程池和编号，外部线程为nullptr
+    static thread_local int curId_;
+
+    TaskQueue inject_;
+    std::mutex overflowMtx_;                //注入队列满时的退路，正常情况下用不到
+    std::deque<Task> overflow_;
+    std::atomic<size_t> overflowSize_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    std::atomic<int> spinning_;
+    std::atomic<int> sleeping_;
+    std::atomic<unsigned> nextWake_;        //轮流唤醒，避免总是叫醒同一个线程
+    std::atomic<bool> isClosed_;
+    bool isPinned_;
+};
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,49 @@
+#include "conntable.h"
+
+ConnTable::ConnTable(int maxFd){
+    //进程能打开的fd有上限，超过的部分用不到
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY &&
+        limit.rlim_cur < (rlim_t)maxFd){
+        maxFd = limit.rlim_cur;
+    }
+    capacity_ = maxFd;
+    slots_.reset(new Slot[capacity_]);
+    for(int i = 0; i < capacity_; i++){
+        slots_[i].gen.store(0, std::memory_order_relaxed);
+        slots_[i].conn = nullptr;
+    }
+}
+
+ConnTable::~ConnTable(){
+    for(int i = 0; i < capacity_; i++){
+        delete slots_[i].conn;
+    }
+}
+
+HttpConn* ConnTable::Acquire(int fd){
+    if(fd < 0 || fd >= capacity_)return nullptr;
+    Slot& slot = slots_[fd];
+    if(!slot.conn){
+        slot.conn = new HttpConn();
+    }
+    uint32_t gen = slot.gen.load(std::memory_order_relaxed);
+    //正常情况下槽是空闲的(偶数)；上一个连接没有走Release时也要换一个新代数
+    slot.gen.store(gen + ((gen & 1) ? 2 : 1), std::memory_order_relaxed);
+    return slot.conn;
+}
+
+void ConnTable::Attach(int fd, HttpConn* conn){
+    assert(fd >= 0 && fd < capacity_ && conn);
+    assert(!slots_[fd].conn);
+    slots_[fd].conn = conn;
+}
+
+void ConnTable::Release(int fd){
+    if(fd < 0 || fd >= capacity_)return;
+    Slot& slot = slots_[fd];
+    uint32_t gen = slot.gen.load(std::memory_order_relaxed);
+    if(gen & 1){
+        slot.gen.store(gen + 1, std::memory_order_relaxed);
+    }
+}
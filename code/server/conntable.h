@@ -0,0 +1,48 @@
+#ifndef CONN_TABLE_H
+#define CONN_TABLE_H
+
+#include <stdint.h>
+#include <assert.h>
+#include <atomic>
+#include <memory>
+#include <sys/resource.h>
+
+#include "../http/httpconn.h"
+
+//按fd下标直接寻址的连接表。槽数组只放代数和指针(热数据，事件分发时只碰它)，
+//HttpConn(冷数据)在fd第一次使用时分配，之后一直复用，地址不会变，工作线程可以放心持有。
+//代数随epoll_event.data.u64一起注册，fd关闭或被复用后同一批里的旧事件对不上代数，直接丢弃
+class ConnTable{
+public:
+    explicit ConnTable(int maxFd);
+    ~ConnTable();
+
+    HttpConn* Acquire(int fd);      //新连接占用fd对应的槽，超出容量返回nullptr
+    //槽里还没有HttpConn时由调用方提供，用于在指定线程上分配(NUMA首次访问)
+    bool Allocated(int fd) const { return fd >= 0 && fd < capacity_ && slots_[fd].conn; }
+    void Attach(int fd, HttpConn* conn);
+    void Release(int fd);           //连接关闭后调用，代数加一，之前注册的事件全部失效
+
+    //事件对应的连接，fd已经关闭或者被新连接复用时返回nullptr
+    HttpConn* Get(int fd, uint32_t gen) const{
+        if(fd < 0 || fd >= capacity_)return nullptr;
+        const Slot& slot = slots_[fd];
+        return slot.gen.load(std::memory_order_relaxed) == gen ? slot.conn : nullptr;
+    }
+    uint32_t Gen(int fd) const{
+        assert(fd >= 0 && fd < capacity_);
+        return slots_[fd].gen.load(std::memory_order_relaxed);
+    }
+    int Capacity() const { return capacity_; }
+
+private:
+    struct Slot{
+        std::atomic<uint32_t> gen;  //奇数表示槽在使用中
+        HttpConn* conn;
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    int capacity_;
+};
+
+#endif
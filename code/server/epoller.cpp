@@ -1,27 +1,28 @@
 #include "epoller.h"
 
-Epoller::Epoller(int maxEvent):epollFd_(epoll_create(512)), events_(maxEvent){
+Epoller::Epoller(int maxEvent):epollFd_(epoll_create(512)), timerFd_(-1), events_(maxEvent){
     assert(epollFd_ >= 0 && events_.size() > 0);
 }
 
 Epoller::~Epoller(){
+    if(timerFd_ >= 0)close(timerFd_);
     close(epollFd_);
 }
 
 //events:需要监听的事件类型（如可读、可写、异常等），是一个位掩码。
-bool Epoller::AddFd(int fd, uint32_t events){
+bool Epoller::AddFd(int fd, uint32_t events, uint32_t gen){
     if(fd < 0)return false;
     epoll_event ev = {0};
-    ev.data.fd = fd;
+    ev.data.u64 = ((uint64_t)gen << 32) | (uint32_t)fd;
     ev.events = events;
     //调用 epoll_ctl，将文件描述符 fd 添加到 epoll 实例中，并指定监听的事件类型 events
     return epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev) == 0;//调用成功返回0
 }
 
-bool Epoller::ModFd(int fd, uint32_t events){
+bool Epoller::ModFd(int fd, uint32_t events, uint32_t gen){
     if(fd < 0)return false;
     epoll_event ev = {0};
-    ev.data.fd = fd;
+    ev.data.u64 = ((uint64_t)gen << 32) | (uint32_t)fd;
     ev.events = events;
     return epoll_ctl(epollFd_ , EPOLL_CTL_MOD, fd, &ev) == 0;
 }
@@ -39,10 +40,42 @@ int Epoller::Wait(int timeoutMs){
 
 int Epoller::GetEventFd(size_t i)const{
     assert(i < events_.size() && i >= 0);
-    return events_[i].data.fd;
+    return (int)(uint32_t)events_[i].data.u64;
+}
+
+uint32_t Epoller::GetEventGen(size_t i)const{
+    assert(i < events_.size() && i >= 0);
+    return events_[i].data.u64 >> 32;
 }
 
 uint32_t Epoller::GetEvents(size_t i)const{
     assert(i < events_.size() && i >= 0);
     return events_[i].events;
-}
\ No newline at end of file
+}
+int Epoller::OpenTimer(){
+    if(timerFd_ >= 0)return timerFd_;
+    timerFd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(timerFd_ >= 0 && !AddFd(timerFd_, EPOLLIN)){
+        close(timerFd_);
+        timerFd_ = -1;
+    }
+    return timerFd_;
+}
+
+void Epoller::SetTimer(int timeoutMs){
+    assert(timerFd_ >= 0);
+    struct itimerspec spec = {};
+    if(timeoutMs >= 0){
+        spec.it_value.tv_sec = timeoutMs / 1000;
+        spec.it_value.tv_nsec = (timeoutMs % 1000) * 1000000L;
+        //全为0表示取消定时，已经到期的用1ns让它立即触发
+        if(timeoutMs == 0)spec.it_value.tv_nsec = 1;
+    }
+    timerfd_settime(timerFd_, 0, &spec, nullptr);
+}
+
+void Epoller::ReadTimer(){
+    uint64_t expirations;
+    ssize_t n = read(timerFd_, &expirations, sizeof(expirations));
+    (void)n;
+}
@@ -2,6 +2,7 @@
 #define EPOLLER_H
 
 #include<sys/epoll.h>
+#include<sys/timerfd.h>
 #include<unistd.h>
 #include<assert.h>
 #include<vector>
@@ -12,15 +13,24 @@ public:
     explicit Epoller(int maxEvent = 1024);
     ~Epoller();
 
-    bool AddFd(int fd, uint32_t events);
-    bool ModFd(int fd, uint32_t events);
+    //gen为连接的代数，和fd一起放在data.u64里，事件返回时用来识别fd复用前的旧事件
+    bool AddFd(int fd, uint32_t events, uint32_t gen = 0);
+    bool ModFd(int fd, uint32_t events, uint32_t gen = 0);
     bool DelFd(int fd);
     int Wait(int timeoutMs = -1);
     int GetEventFd(size_t i)const;
+    uint32_t GetEventGen(size_t i)const;
     uint32_t GetEvents(size_t i)const;
 
+    //定时器用的timerfd，可读时表示到期，没有打开时为-1
+    int OpenTimer();
+    int TimerFd()const { return timerFd_; }
+    void SetTimer(int timeoutMs);   //一次性定时，重新设置会覆盖上一次
+    void ReadTimer();               //读掉到期次数，否则LT模式下会一直可读
+
 private:
     int epollFd_;
+    int timerFd_;
     std::vector<struct epoll_event>events_;
 };
 
@@ -0,0 +1,265 @@
+#include "subreactor.h"
+
+using namespace std;
+
+SubReactor::SubReactor(int id, int maxFd, int timeoutMs, uint32_t connEvent, int timerSlackMs):
+    id_(id), maxFd_(maxFd), timeoutMs_(timeoutMs), connEvent_(connEvent), listenFd_(-1), listenET_(false), cpu_(-1),
+    isClose_(false), connCount_(0),
+    epoller_(new Epoller()), timer_(new TimingWheel(&SubReactor::OnTimeout_, this, timerSlackMs)),
+    users_(maxFd){
+    //eventfd用于跨线程唤醒阻塞在epoll_wait上的循环
+    wakeupFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    assert(wakeupFd_ >= 0);
+    epoller_->AddFd(wakeupFd_, EPOLLIN);
+    if(timeoutMs_ > 0 && epoller_->OpenTimer() < 0){
+        LOG_WARN("Reactor[%d] timerfd error, fall back to epoll_wait timeout", id_);
+    }
+}
+
+SubReactor::~SubReactor(){
+    Stop();
+    close(wakeupFd_);
+    if(listenFd_ >= 0)close(listenFd_);
+}
+
+void SubReactor::Start(){
+    thread_ = std::thread(&SubReactor::Loop_, this);
+    if(cpu_ >= 0){
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu_, &set);
+        if(pthread_setaffinity_np(thread_.native_handle(), sizeof(set), &set) != 0){
+            LOG_WARN("Reactor[%d] bind cpu %d error!", id_, cpu_);
+        }
+    }
+}
+
+void SubReactor::AddListener(int listenFd, uint32_t listenEvent){
+    assert(listenFd >= 0 && listenFd_ < 0);
+    listenFd_ = listenFd;
+    listenET_ = listenEvent & EPOLLET;
+    epoller_->AddFd(listenFd_, listenEvent);
+}
+
+void SubReactor::Stop(){
+    isClose_ = true;
+    if(thread_.joinable()){
+        Wakeup_();
+        thread_.join();
+    }
+}
+
+void SubReactor::AddConn(int fd, const sockaddr_in& addr){
+    connCount_++;
+    RunInLoop(std::bind(&SubReactor::AddClient_, this, fd, addr));
+}
+
+void SubReactor::RunInLoop(std::function<void()> task){
+    {
+        lock_guard<mutex> locker(mtx_);
+        pendingTasks_.push_back(std::move(task));
+    }
+    Wakeup_();
+}
+
+void SubReactor::Wakeup_(){
+    uint64_t one = 1;
+    ssize_t n = ::write(wakeupFd_, &one, sizeof(one));
+    if(n != sizeof(one)){
+        LOG_WARN("Reactor[%d] wakeup error!", id_);
+    }
+}
+
+void SubReactor::HandleWakeup_(){
+    uint64_t cnt = 0;
+    ssize_t n = ::read(wakeupFd_, &cnt, sizeof(cnt));
+    if(n != sizeof(cnt) && errno != EAGAIN){
+        LOG_WARN("Reactor[%d] read wakeup error!", id_);
+    }
+}
+
+void SubReactor::DoPendingTasks_(){
+    //交换出来再执行，缩短持锁时间，也允许任务里再次投递
+    vector<function<void()>> tasks;
+    {
+        lock_guard<mutex> locker(mtx_);
+        tasks.swap(pendingTasks_);
+    }
+    for(auto& task: tasks){
+        task();
+    }
+}
+
+void SubReactor::Loop_(){
+    int timeMS = -1;
+    int timerFd = epoller_->TimerFd();
+    LOG_INFO("Reactor[%d] start", id_);
+    while(!isClose_){
+        if(timeoutMs_ > 0){
+            if(timerFd < 0){
+                timeMS = timer_->GetNextTick();
+            }else if(timer_->NeedRearm(&timeMS)){
+                //只有出现更早的到期时间才改timerfd，其余时候epoll_wait不带超时
+                epoller_->SetTimer(timeMS);
+            }
+        }
+        int eventCnt = epoller_->Wait(timerFd < 0 ? timeMS : -1);
+        bool timerExpired = false;
+        for(int i = 0; i < eventCnt; i++){
+            int fd = epoller_->GetEventFd(i);
+            uint32_t events = epoller_->GetEvents(i);
+            if(fd == listenFd_){
+                DealListen_();
+            }else if(fd == wakeupFd_){
+                HandleWakeup_();
+            }else if(fd == timerFd){
+                //同一批里后面的事件可能属于将要超时的连接，先处理完事件再批量处理到期
+                epoller_->ReadTimer();
+                timerExpired = true;
+            }else if(HttpConn* client = users_.Get(fd, epoller_->GetEventGen(i))){
+                if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)){
+                    CloseConn_(client);
+                }else if(events & EPOLLIN){
+                    DealRead_(client);
+                }else if(events & EPOLLOUT){
+                    DealWrite_(client);
+                }else{
+                    LOG_ERROR("Reactor[%d] unexpected event", id_);
+                }
+            }else{
+                //同一批里前面的事件已经关闭了这个连接(fd可能已被新连接复用)
+                LOG_DEBUG("Reactor[%d] stale event on fd %d", id_, fd);
+            }
+        }
+        if(timerExpired)timer_->Tick();
+        DoPendingTasks_();
+    }
+    LOG_INFO("Reactor[%d] quit", id_);
+}
+
+void SubReactor::DealListen_(){
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    do{
+        int fd = accept4(listenFd_, (struct sockaddr *)&addr, &len, SOCK_NONBLOCK);
+        if(fd <= 0)return;
+        else if(HttpConn::userCount >= maxFd_){
+            const char info[] = "Server busy!";
+            send(fd, info, sizeof(info) - 1, 0);
+            close(fd);
+            LOG_WARN("Reactor[%d] clients is full!", id_);
+            return;
+        }
+        connCount_++;
+        AddClient_(fd, addr);
+    }while(listenET_);
+}
+
+void SubReactor::AddClient_(int fd, sockaddr_in addr){
+    assert(fd > 0);
+    HttpConn* client = users_.Acquire(fd);
+    if(!client){
+        LOG_WARN("Reactor[%d] fd %d exceeds connection table!", id_, fd);
+        close(fd);
+        connCount_--;
+        return;
+    }
+    client->init(fd, addr);
+    if(timeoutMs_ > 0){
+        client->Timer()->kind = HttpConn::IDLE_TIMER;
+        timer_->Add(client->Timer(), HttpConn::timeoutMs[HttpConn::IDLE_TIMER]);
+    }
+    epoller_->AddFd(fd, EPOLLIN | connEvent_, users_.Gen(fd));
+}
+
+void SubReactor::CloseConn_(HttpConn* client){
+    assert(client);
+    timer_->Del(client->Timer());
+    if(client->IsClosed())return;
+    LOG_INFO("Reactor[%d] client[%d] quit!", id_, client->GetFd());
+    epoller_->DelFd(client->GetFd());
+    users_.Release(client->GetFd());
+    client->Close();
+    connCount_--;
+}
+
+//按连接当前所处阶段设置超时，读写处理完之后调用
+void SubReactor::UpdateTimer_(HttpConn* client){
+    assert(client);
+    if(timeoutMs_ <= 0 || client->IsClosed())return;
+    TimerNode* node = client->Timer();
+    HttpConn::TIMER_KIND kind = client->TimerKind();
+    //头部超时从请求开始算，慢速发送头部(slowloris)不能靠零星的数据一直占住连接
+    if(kind == HttpConn::HEADER_TIMER && node->kind == kind && node->Linked())return;
+    node->kind = kind;
+    timer_->Add(node, HttpConn::timeoutMs[kind]);
+}
+
+void SubReactor::OnTimeout_(void* arg, TimerNode* node){
+    static_cast<SubReactor*>(arg)->CloseConn_(static_cast<HttpConn*>(node->data));
+}
+
+void SubReactor::DealRead_(HttpConn* client){
+    assert(client);
+    int readErrno = 0;
+    ssize_t ret = client->read(&readErrno);
+    if(ret <= 0 && readErrno != EAGAIN){
+        CloseConn_(client);
+        return;
+    }
+    if(client->process()){
+        //响应生成后直接在本线程尝试写，写不完再注册EPOLLOUT
+        Write_(client, false);
+    }else if(client->NeedVerify()){
+        Verify_(client);
+    }
+    UpdateTimer_(client);
+}
+
+//查询在DbExecutor线程上执行，不占用本循环；完成后投递回来，连接在等待期间关闭或被复用时丢弃结果。
+//等待期间EPOLLIN仍然注册着，新到的数据先留在读缓冲区
+void SubReactor::Verify_(HttpConn* client){
+    int fd = client->GetFd();
+    uint32_t gen = users_.Gen(fd);
+    bool submitted = client->StartVerify([this, client, fd, gen](bool ok){
+        RunInLoop([this, client, fd, gen, ok](){
+            if(users_.Get(fd, gen) != client || client->IsClosed())return;
+            if(client->FinishVerify(ok))Write_(client, false);
+            UpdateTimer_(client);
+        });
+    });
+    if(!submitted && client->FinishVerify(false)){
+        //数据库排队已满，直接按失败处理
+        Write_(client, false);
+    }
+}
+
+void SubReactor::DealWrite_(HttpConn* client){
+    assert(client);
+    Write_(client, true);
+    UpdateTimer_(client);
+}
+
+//armedOut：当前是否已经在监听EPOLLOUT，避免无谓的epoll_ctl
+void SubReactor::Write_(HttpConn* client, bool armedOut){
+    int writeErrno = 0;
+    ssize_t ret = client->write(&writeErrno);
+    while(client->ToWriteBytes() == 0 && client->IsKeepAlive() && client->HasBufferedData()){
+        //上一批响应发完了，读缓冲区里还有流水线请求，继续处理
+        if(!client->process())break;
+        ret = client->write(&writeErrno);
+    }
+    if(client->ToWriteBytes() == 0){
+        if(client->IsKeepAlive()){
+            if(armedOut)epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN, users_.Gen(client->GetFd()));
+            //流水线里的下一个请求需要查数据库
+            if(client->NeedVerify())Verify_(client);
+            return;
+        }
+    }else if(ret > 0 || writeErrno == EAGAIN){
+        //内核发送缓冲区满，或者本轮写够了，剩余数据等可写事件再发
+        if(!armedOut)epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT, users_.Gen(client->GetFd()));
+        return;
+    }
+    CloseConn_(client);
+}
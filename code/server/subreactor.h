@@ -0,0 +1,78 @@
+#ifndef SUB_REACTOR_H
+#define SUB_REACTOR_H
+
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "epoller.h"
+#include "conntable.h"
+#include "../timer/timingwheel.h"
+#include "../log/log.h"
+#include "../http/httpconn.h"
+#include "../pool/dbexecutor.h"
+
+//从reactor：每个线程一个事件循环，独占自己的Epoller、定时器和分配到的连接，
+//连接的读、解析、写都在本线程完成，不经过线程池
+class SubReactor{
+public:
+    //maxFd为整个服务器的连接上限，由WebServer统一传入
+    SubReactor(int id, int maxFd, int timeoutMs, uint32_t connEvent, int timerSlackMs = 1);
+    ~SubReactor();
+
+    void Start();
+    void Stop();
+
+    void AddListener(int listenFd, uint32_t listenEvent); //SO_REUSEPORT模式下本循环自己accept
+    void SetCpu(int cpu) { cpu_ = cpu; }                  //Start之前设置，-1表示不绑核
+    void AddConn(int fd, const sockaddr_in& addr);    //由主reactor(acceptor)线程调用
+    void RunInLoop(std::function<void()> task);       //把任务投递到本循环线程执行
+
+    int ConnCount() const { return connCount_; }
+    int Id() const { return id_; }
+
+private:
+    void Loop_();
+    void Wakeup_();
+    void HandleWakeup_();
+    void DoPendingTasks_();
+
+    void DealListen_();
+    void AddClient_(int fd, sockaddr_in addr);
+    void DealRead_(HttpConn* client);
+    void DealWrite_(HttpConn* client);
+    void Write_(HttpConn* client, bool armedOut);
+    void Verify_(HttpConn* client);
+    void UpdateTimer_(HttpConn* client);
+    void CloseConn_(HttpConn* client);
+    static void OnTimeout_(void* arg, TimerNode* node);
+
+    int id_;
+    int maxFd_;
+    int timeoutMs_;         //<=0时不启用连接超时，各阶段的超时见HttpConn::timeoutMs
+    uint32_t connEvent_;
+    int wakeupFd_;
+    int listenFd_;
+    bool listenET_;
+    int cpu_;
+    std::atomic<bool> isClose_;
+    std::atomic<int> connCount_;
+
+    std::unique_ptr<Epoller> epoller_;
+    std::unique_ptr<TimingWheel> timer_;
+    ConnTable users_;       //只在本循环线程访问
+
+    std::mutex mtx_;
+    std::vector<std::function<void()>> pendingTasks_;
+    std::thread thread_;
+
+};
+
+#endif
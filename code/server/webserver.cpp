@@ -2,46 +2,132 @@
 
 using namespace std;
 
-WebServer::WebServer(int port,int trigMode, int timeoutMs, bool OptLinger,
-    int sqlPort, const char* sqlUser, const char* sqlPwd,
-    const char* dbName, int connPoolNum ,int threadNum,
-    bool openLog, int logLevel, int logQueSize):
-    port_(port), openLinger_(OptLinger), timeoutMs_(timeoutMs), isClose_(false),
-            timer_(new HeapTimer()), threadpool_(new ThreadPool(threadNum)), epoller_(new Epoller()){
+WebServer::WebServer(const ServerConfig& config):
+    port_(config.port), openLinger_(config.optLinger), timeoutMs_(config.timeoutMs), isClose_(false),
+            listenFd_(-1), backlog_(config.backlog), dispatchMode_(config.dispatchMode), nextReactor_(0),
+            connAffinity_(config.connAffinity),
+            timer_(new TimingWheel(&WebServer::OnTimeout_, this, config.timerSlackMs)), epoller_(new Epoller()),
+            users_(MAX_FD), wakeupFd_(-1){
 
+    //sendfile/splice没有MSG_NOSIGNAL，对端关闭后再发送会收到SIGPIPE，忽略它，只处理EPIPE
+    signal(SIGPIPE, SIG_IGN);
     srcDir_ = getcwd(nullptr, 256);
     assert(srcDir_);
     strncat(srcDir_, "/resources/", 16);
     HttpConn::userCount = 0;
     HttpConn::srcDir = srcDir_;
+    HttpResponse::sendMode = config.sendMode;
+    HttpRequest::maxBodySize = config.maxBodySize;
+    HttpRequest::spillSize = config.bodySpillSize;
+    HttpResponse::autoIndex = config.autoIndex;
+    HttpResponse::gzipStatic = config.gzipStatic;
+    //各阶段的超时没有单独设置时沿用空闲超时
+    int timeoutMs = config.timeoutMs;
+    HttpConn::timeoutMs[HttpConn::IDLE_TIMER] = timeoutMs;
+    HttpConn::timeoutMs[HttpConn::HEADER_TIMER] = config.headerTimeoutMs > 0 ? config.headerTimeoutMs : timeoutMs;
+    HttpConn::timeoutMs[HttpConn::BODY_TIMER] = config.bodyTimeoutMs > 0 ? config.bodyTimeoutMs : timeoutMs;
+    HttpConn::timeoutMs[HttpConn::WRITE_TIMER] = config.writeTimeoutMs > 0 ? config.writeTimeoutMs : timeoutMs;
 
-    SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);
-    InitEventMode_(trigMode);
+    SqlConnPool::Instance()->Init("localhost", config.sqlPort, config.sqlUser, config.sqlPwd, config.dbName,
+                                  config.connPoolNum, config.sqlConnMax, config.sqlWaitMs);
+    //每个执行器线程同一时刻最多占用一个数据库连接，线程数按连接池上限开
+    DbExecutor::Instance()->Init(config.sqlConnMax > config.connPoolNum ? config.sqlConnMax : config.connPoolNum);
+    if(config.regBatchSize > 0){
+        RegisterWriter::Instance()->Init(config.regBatchSize, config.regBatchWaitUs);
+    }
+    InitEventMode_(config.trigMode);
+    if(config.fileCacheNum > 0){
+        //mmap模式下缓存项同时保存长期映射，省掉每次请求的mmap/munmap
+        FileCache::Instance()->Init(srcDir_, config.fileCacheNum, config.sendMode == HttpResponse::MMAP_WRITEV,
+                                    config.hashETag);
+    }
+    if(config.gzipCacheSize > 0){
+        CompressCache::Instance()->Init(config.gzipCacheSize);
+    }
+    if(config.respCacheSize > 0){
+        ResponseCache::Instance()->Init(config.respCacheSize);
+    }
+    if(config.authCacheNum > 0){
+        AuthCache::Instance()->Init(config.authCacheNum, config.authCacheTtlMs);
+    }
+    if(config.reactorNum > 0){
+        //主从reactor模式：连接由从reactor独占，不需要EPOLLONESHOT防止多线程同时处理
+        for(int i = 0; i < config.reactorNum; i++){
+            reactors_.emplace_back(new SubReactor(i, MAX_FD, timeoutMs_, connEvent_ & ~EPOLLONESHOT, config.timerSlackMs));
+        }
+    }else{
+        threadpool_.reset(new ThreadPool(config.threadNum));
+        if(timeoutMs_ > 0)epoller_->OpenTimer();
+        //数据库查询完成后回到主线程，和超时关闭连接串行执行
+        wakeupFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        assert(wakeupFd_ >= 0);
+        epoller_->AddFd(wakeupFd_, EPOLLIN);
+    }
     if(!InitSocket_()) isClose_ = true;
 
-    if(openLog){
-        Log::Instance()->init(logLevel, "./log", ".log", logQueSize);
+    if(config.openLog){
+        //BINARY格式的日志文件用bin/logdecode还原
+        Log::Instance()->init(config.logLevel, "./log", config.logFormat == Log::BINARY ? ".bin" : ".log",
+                              config.logQueSize, config.logFormat);
         if(isClose_){
             LOG_ERROR("======== Server init error! ========");
         }
         else{
             LOG_INFO("======== Server init ========");
-            LOG_INFO("Port: %d, OpenLinger: %s", port_, openLinger_ ? "true" : "false");
+            LOG_INFO("Port: %d, OpenLinger: %s, Backlog: %d", port_, openLinger_ ? "true" : "false", backlog_);
             LOG_INFO("Listen Mode: %s, OpenConn Mode: %s", 
             (listenEvent_ & EPOLLET ? "ET" : "LT"),
             (connEvent_ & EPOLLET ? "ET": "LT"));
-            LOG_INFO("LogSys level: %d", logLevel);
-            LOG_INFO("srcDir: %s", HttpConn::srcDir);
-            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, threadNum);
+            const char* sendModes[] = {"mmap+writev", "sendfile", "splice"};
+            const char* logFormats[] = {"text", "deferred", "binary"};
+            LOG_INFO("LogSys level: %d, format: %s, Send Mode: %s", config.logLevel,
+                logFormats[Log::Instance()->IsDeferred() && config.logFormat <= 2 ? config.logFormat : 0],
+                sendModes[config.sendMode >= 0 && config.sendMode <= 2 ? config.sendMode : 0]);
+            LOG_INFO("Request parser scan: %s", Scanner::Impl());
+            LOG_INFO("srcDir: %s, FileCache num: %d, ResponseCache size: %d", HttpConn::srcDir,
+                config.fileCacheNum, ResponseCache::Instance()->IsOpen() ? config.respCacheSize : 0);
+            LOG_INFO("Max body size: %d, Body spill size: %d, AutoIndex: %s", config.maxBodySize,
+                config.bodySpillSize, config.autoIndex ? "true" : "false");
+            LOG_INFO("Gzip static: %s, Gzip cache size: %d", config.gzipStatic ? "true" : "false",
+                CompressCache::Instance()->IsOpen() ? config.gzipCacheSize : 0);
+            LOG_INFO("AuthCache num: %d, ttl: %d", AuthCache::Instance()->IsOpen() ? config.authCacheNum : 0,
+                config.authCacheTtlMs);
+            LOG_INFO("Timeout idle: %d, header: %d, body: %d, write: %d, slack: %d",
+                HttpConn::timeoutMs[HttpConn::IDLE_TIMER], HttpConn::timeoutMs[HttpConn::HEADER_TIMER],
+                HttpConn::timeoutMs[HttpConn::BODY_TIMER], HttpConn::timeoutMs[HttpConn::WRITE_TIMER],
+                config.timerSlackMs);
+            LOG_INFO("SqlConnPool max: %d, wait: %d, connected: %d",
+                config.sqlConnMax > config.connPoolNum ? config.sqlConnMax : config.connPoolNum, config.sqlWaitMs,
+                SqlConnPool::Instance()->GetStats().connCount);
+            LOG_INFO("Register batch: %d, wait: %dus", RegisterWriter::Instance()->IsOpen() ? config.regBatchSize : 0,
+                config.regBatchWaitUs);
+            if(reactors_.empty()){
+                LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d, Conn affinity: %s", config.connPoolNum,
+                    config.threadNum, connAffinity_ ? "true" : "false");
+            }else{
+                const char* dispatch[] = {"round-robin", "least-loaded", "reuseport", "reuseport-cpu"};
+                LOG_INFO("SqlConnPool num: %d, SubReactor num: %d, Dispatch: %s", config.connPoolNum,
+                    config.reactorNum, dispatch[dispatchMode_ >= 0 && dispatchMode_ <= 3 ? dispatchMode_ : 0]);
+            }
         }
     }
 }
 
 WebServer::~WebServer(){
-    close(listenFd_);
+    if(listenFd_ >= 0)close(listenFd_);
     isClose_ = true;
+    //先停执行器，查询完成的回调会投递到从reactor和主线程
+    DbExecutor::Instance()->Close();
+    RegisterWriter::Instance()->Close();
+    reactors_.clear();
+    threadpool_.reset();    //等工作线程处理完手上的任务再释放连接和数据库连接池
+    if(wakeupFd_ >= 0)close(wakeupFd_);
     free(srcDir_);
     SqlConnPool::Instance()->ClosePool();
+    ResponseCache::Instance()->Close();
+    CompressCache::Instance()->Close();
+    AuthCache::Instance()->Close();
+    FileCache::Instance()->Close();
 }
 
 void WebServer::InitEventMode_(int trigMode){
@@ -72,36 +158,79 @@ void WebServer::Start(){
     int timeMS = -1;
     
     if(!isClose_)LOG_INFO("======== Server start ========");
+    for(auto& reactor: reactors_){
+        reactor->Start();
+    }
     
+    int timerFd = epoller_->TimerFd();
     while(!isClose_){
         if(timeoutMs_ > 0){
-            timeMS = timer_->GetNextTick();
+            if(timerFd < 0){
+                timeMS = timer_->GetNextTick();
+            }else if(timer_->NeedRearm(&timeMS)){
+                //只有出现更早的到期时间才改timerfd，其余时候epoll_wait不带超时
+                epoller_->SetTimer(timeMS);
+            }
         }
-        int eventCnt = epoller_->Wait(timeMS);
+        int eventCnt = epoller_->Wait(timerFd < 0 ? timeMS : -1);
+        bool timerExpired = false;
         for(int i = 0; i < eventCnt; i ++){
             //处理事件
             int fd = epoller_->GetEventFd(i);
             uint32_t events = epoller_->GetEvents(i);
             if(fd == listenFd_){
                 DealListen_();
-            }else if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)){
-                //对端关闭连接（半关闭）\ 对端完全关闭连接 \ 发生错误
-                assert(users_.count(fd) > 0);
-                CloseConn_(&users_[fd]);
-            }else if(events & EPOLLIN){
-                assert(users_.count(fd) > 0);
-                DealRead_(&users_[fd]);
-            }else if(events & EPOLLOUT){
-                assert(users_.count(fd) > 0);
-                DealWrite_(&users_[fd]);
+            }else if(fd == wakeupFd_){
+                uint64_t one;
+                ssize_t n = ::read(wakeupFd_, &one, sizeof(one));
+                (void)n;
+            }else if(fd == timerFd){
+                //先处理完这一批事件再批量处理到期，已经有新事件的连接不会被误关
+                epoller_->ReadTimer();
+                timerExpired = true;
+            }else if(HttpConn* client = users_.Get(fd, epoller_->GetEventGen(i))){
+                if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)){
+                    //对端关闭连接（半关闭）\ 对端完全关闭连接 \ 发生错误
+                    CloseConn_(client);
+                }else if(events & EPOLLIN){
+                    DealRead_(client);
+                }else if(events & EPOLLOUT){
+                    DealWrite_(client);
+                }else{
+                    LOG_ERROR("Unexpected event");
+                }
             }else{
-                LOG_ERROR("Unexpected event");
+                //连接已经关闭，fd可能已被新连接复用，这是旧连接的事件
+                LOG_DEBUG("Stale event on fd %d", fd);
             }
         }
+        if(timerExpired)timer_->Tick();
+        DoPendingTasks_();
     }
 
 }
 
+void WebServer::RunInLoop_(std::function<void()> task){
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        pendingTasks_.push_back(std::move(task));
+    }
+    uint64_t one = 1;
+    ssize_t n = ::write(wakeupFd_, &one, sizeof(one));
+    (void)n;
+}
+
+void WebServer::DoPendingTasks_(){
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        tasks.swap(pendingTasks_);
+    }
+    for(auto& task: tasks){
+        task();
+    }
+}
+
 void WebServer::SendError_(int fd, const char* info){
     assert(fd > 0);
     int ret = send(fd, info, strlen(info), 0);
@@ -113,23 +242,37 @@ void WebServer::SendError_(int fd, const char* info){
 
 void WebServer::CloseConn_(HttpConn* client){
     assert(client);
+    if(client->IsClosed())return;
     LOG_INFO("Client[%d] quit!", client->GetFd());
     epoller_->DelFd(client->GetFd());
+    users_.Release(client->GetFd());
     client->Close();
 }
 
 void WebServer::AddClient_(int fd, sockaddr_in addr){
     assert(fd > 0);
-    users_[fd].init(fd, addr);
+    if(connAffinity_ && threadpool_ && threadpool_->IsPinned() && !users_.Allocated(fd) &&
+        fd < users_.Capacity()){
+        //分配完成后再回到这里注册，主线程不等待
+        AllocConn_(fd, addr);
+        return;
+    }
+    HttpConn* client = users_.Acquire(fd);
+    if(!client){
+        SendError_(fd, "Server busy!");
+        LOG_WARN("Client fd %d exceeds connection table!", fd);
+        return;
+    }
+    client->init(fd, addr);
     if(timeoutMs_ > 0){
-        //超时后回调CloseConn_()
-        //成员函数需要通过对象指针调用，因此绑定成员函数时需要绑定对象指针，&users_[fd]是传入的参数
-        timer_->add(fd, timeoutMs_, std::bind(&WebServer::CloseConn_, this, &users_[fd]));
+        //超时后由OnTimeout_回调CloseConn_()，节点嵌在HttpConn里，fd复用时直接重新设置
+        client->Timer()->kind = HttpConn::IDLE_TIMER;
+        timer_->Add(client->Timer(), HttpConn::timeoutMs[HttpConn::IDLE_TIMER]);
     }
-    epoller_->AddFd(fd, EPOLLIN | connEvent_);
+    epoller_->AddFd(fd, EPOLLIN | connEvent_, users_.Gen(fd));
     //将fd 设置为非阻塞模式，非阻塞模式下，read 和 write 函数会立即返回，而不是阻塞等待数据可用
     SetFdNonblock(fd);
-    LOG_INFO("Client[%d] in!", users_[fd].GetFd());
+    LOG_INFO("Client[%d] in!", client->GetFd());
 }
 
 //当客户端通过 connect 连接到服务器时，连接请求会被放入监听套接字的连接队列中。
@@ -146,26 +289,86 @@ void WebServer::DealListen_(){
             LOG_WARN("Clients is full!");
             return;
         }
+        if(!reactors_.empty()){
+            //主reactor只负责accept，连接交给从reactor
+            SetFdNonblock(fd);
+            NextReactor_()->AddConn(fd, addr);
+            continue;
+        }
         AddClient_(fd,addr);
     }while(listenEvent_ & EPOLLET);//如果是边缘触发就循环处理，水平触发则只调用一次
 }
 
+SubReactor* WebServer::NextReactor_(){
+    assert(!reactors_.empty());
+    if(dispatchMode_ == 1){
+        SubReactor* least = reactors_[0].get();
+        for(auto& reactor: reactors_){
+            if(reactor->ConnCount() < least->ConnCount())least = reactor.get();
+        }
+        return least;
+    }
+    SubReactor* reactor = reactors_[nextReactor_].get();
+    nextReactor_ = (nextReactor_ + 1) % reactors_.size();
+    return reactor;
+}
+
+//工作线程绑核后，让负责这个fd的线程分配HttpConn：按首次访问的规则，对象所在的内存页
+//落在该线程的NUMA节点上。每个fd只在第一次使用时分配一次，之后一直复用。
+//分配好后投递回主线程挂到连接表上并注册事件，这期间fd还没加入epoll，不会有事件；
+//那个线程忙时只推迟这一个连接，不会卡住accept和其他连接的事件分发
+void WebServer::AllocConn_(int fd, sockaddr_in addr){
+    threadpool_->AddTask(fd, [this, fd, addr](){
+        //服务器退出时没执行到的任务随unique_ptr释放连接
+        auto conn = std::make_shared<std::unique_ptr<HttpConn>>(new HttpConn());
+        RunInLoop_([this, fd, addr, conn](){
+            users_.Attach(fd, conn->release());
+            AddClient_(fd, addr);
+        });
+    });
+}
+
 //处理读事件，将onread加入线程池的任务队列中
 void WebServer::DealRead_(HttpConn* client){
     assert(client);
-    ExtentTime_(client);
-    threadpool_->AddTask(std::bind(&WebServer::OnRead_,this,client));
+    UpdateTimer_(client);
+    if(connAffinity_){
+        //同一个连接的读写都在同一个线程上，缓冲区和请求状态不会在核之间来回迁移
+        threadpool_->AddTask(client->GetFd(), std::bind(&WebServer::OnRead_,this,client));
+    }else{
+        threadpool_->AddTask(std::bind(&WebServer::OnRead_,this,client));
+    }
 }
 
 void WebServer::DealWrite_(HttpConn* client){
     assert(client);
-    ExtentTime_(client);
-    threadpool_->AddTask(std::bind(&WebServer::OnWrite_,this,client));
+    UpdateTimer_(client);
+    if(connAffinity_){
+        threadpool_->AddTask(client->GetFd(), std::bind(&WebServer::OnWrite_,this,client));
+    }else{
+        threadpool_->AddTask(std::bind(&WebServer::OnWrite_,this,client));
+    }
 }
 
-void WebServer::ExtentTime_(HttpConn* client){
+//在主线程、交给工作线程之前调用：EPOLLONESHOT保证此时没有工作线程在处理这个连接，
+//看到的是等待这次事件时所处的阶段
+void WebServer::UpdateTimer_(HttpConn* client){
     assert(client);
-    if(timeoutMs_ > 0)timer_->adjust(client->GetFd(), timeoutMs_);
+    if(timeoutMs_ <= 0)return;
+    TimerNode* node = client->Timer();
+    HttpConn::TIMER_KIND kind = client->TimerKind();
+    //头部超时从请求开始算，慢速发送头部(slowloris)不能靠零星的数据一直占住连接
+    if(kind == HttpConn::HEADER_TIMER && node->kind == kind && node->Linked())return;
+    node->kind = kind;
+    timer_->Add(node, HttpConn::timeoutMs[kind]);
+}
+
+//时间轮只在主线程访问；工作线程里关闭的连接节点还留在轮中，到期时跳过
+void WebServer::OnTimeout_(void* arg, TimerNode* node){
+    HttpConn* client = static_cast<HttpConn*>(node->data);
+    if(!client->IsClosed()){
+        static_cast<WebServer*>(arg)->CloseConn_(client);
+    }
 }
 
 void WebServer::OnRead_(HttpConn* client){
@@ -184,10 +387,43 @@ void WebServer::OnProcess_(HttpConn* client){
     if(client->process()){
         //返回 true，表示处理成功，并且需要向客户端发送响应数据。
         //将事件设置为 connEvent_ | EPOLLOUT，表示监听写事件（准备向客户端发送数据）
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
+        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT, users_.Gen(client->GetFd()));
+    }else if(client->NeedVerify()){
+        //查询期间不注册任何事件(EPOLLONESHOT)，查完由OnVerified_重新注册
+        Verify_(client);
     }else{
         //否则继续监听读事件，等待接收客户端发送数据
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN);
+        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN, users_.Gen(client->GetFd()));
+    }
+}
+
+//在工作线程上调用，查询在DbExecutor线程上执行，完成后先回到主线程确认连接没有在等待期间
+//超时关闭(或fd被新连接复用)，再交给工作线程生成响应
+void WebServer::Verify_(HttpConn* client){
+    int fd = client->GetFd();
+    uint32_t gen = users_.Gen(fd);
+    bool submitted = client->StartVerify([this, client, fd, gen](bool ok){
+        RunInLoop_([this, client, fd, gen, ok](){
+            if(users_.Get(fd, gen) != client || client->IsClosed())return;
+            UpdateTimer_(client);
+            if(connAffinity_){
+                threadpool_->AddTask(fd, std::bind(&WebServer::OnVerified_, this, client, ok));
+            }else{
+                threadpool_->AddTask(std::bind(&WebServer::OnVerified_, this, client, ok));
+            }
+        });
+    });
+    if(!submitted){
+        //数据库排队已满，直接按失败处理
+        OnVerified_(client, false);
+    }
+}
+
+void WebServer::OnVerified_(HttpConn* client, bool ok){
+    if(client->FinishVerify(ok)){
+        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT, users_.Gen(client->GetFd()));
+    }else{
+        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN, users_.Gen(client->GetFd()));
     }
 }
 
@@ -197,25 +433,76 @@ void WebServer::OnWrite_(HttpConn* client){
     int writeErrno = 0;
     ret = client->write(&writeErrno);
     if(client->ToWriteBytes() == 0){//所有数据都写入了
-        if(client->IsKeepAlive()){//连接需要保持，切换监听事件，监听读，等客户端发送新数据
-            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN);
+        if(client->IsKeepAlive()){//连接需要保持
+            if(client->HasBufferedData()){
+                //读缓冲区里还有流水线请求，接着处理
+                OnProcess_(client);
+                return ;
+            }
+            //切换监听事件，监听读，等客户端发送新数据
+            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN, users_.Gen(client->GetFd()));
             return ;
         }
-    }else if(ret < 0){
-        if(writeErrno == EAGAIN){//缓冲区写满了，监听写，等缓冲区可写时继续写入数据
-            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
-        }
+    }else if(ret > 0 || writeErrno == EAGAIN){
+        //缓冲区写满了(或LT模式下本轮写够了)，监听写，等缓冲区可写时从断点继续写入数据
+        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT, users_.Gen(client->GetFd()));
+        return ;
     }
     CloseConn_(client);
 }
 
 bool WebServer::InitSocket_(){
-    int ret;
-    struct sockaddr_in addr;
     if(port_ > 65535 || port_ < 1024){
         LOG_ERROR("Port:%d error!", port_);
         return false;
     }
+    if(backlog_ <= 0){
+        LOG_ERROR("Backlog:%d error!", backlog_);
+        return false;
+    }
+
+    if(dispatchMode_ >= 2 && !reactors_.empty()){
+        //SO_REUSEPORT分片：每个从reactor一个监听套接字，由内核在它们之间分配连接
+        std::vector<int> fds;
+        for(size_t i = 0; i < reactors_.size(); i++){
+            int fd = CreateListenFd_(true);
+            if(fd < 0){
+                for(int openFd: fds)close(openFd);
+                return false;
+            }
+            fds.push_back(fd);
+        }
+        //CBPF按处理软中断的CPU编号选择监听套接字：CPU c -> 第 c % N 个套接字
+        if(dispatchMode_ == 3 && !AttachCpuSteering_(fds[0], fds.size())){
+            LOG_WARN("Attach reuseport CBPF error: %s, fallback to hash", strerror(errno));
+        }
+        for(size_t i = 0; i < reactors_.size(); i++){
+            reactors_[i]->AddListener(fds[i], listenEvent_ | EPOLLIN);
+        }
+        listenFd_ = -1;
+        LOG_INFO("Server port:%d, %d reuseport listeners", port_, (int)fds.size());
+        return true;
+    }
+
+    listenFd_ = CreateListenFd_(false);
+    if(listenFd_ < 0){
+        return false;
+    }
+    //添加到epoll监听器
+    int ret = epoller_->AddFd(listenFd_, listenEvent_ | EPOLLIN);
+    if(ret == 0){
+        LOG_ERROR("Add listen error!");
+        close(listenFd_);
+        return false;
+    }
+    LOG_INFO("Server port:%d", port_);
+    return true;
+}
+
+//创建、配置、绑定并监听一个套接字，失败返回-1
+int WebServer::CreateListenFd_(bool reusePort){
+    int ret;
+    struct sockaddr_in addr;
     addr.sin_family = AF_INET;//使用 IPv4 地址
     addr.sin_addr.s_addr = htonl(INADDR_ANY);//即监听所有网络接口的连接请求
     addr.sin_port = htons(port_);//将主机字节序（host byte order）转换为网络字节序（network byte order）
@@ -228,55 +515,85 @@ bool WebServer::InitSocket_(){
         optLinger.l_linger = 1;//延迟等待1s，等待数据发送完毕或连接关闭
     }
 
-    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);//使用IPV4,使用TCP协议
-    if(listenFd_ < 0){
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);//使用IPV4,使用TCP协议
+    if(listenFd < 0){
         LOG_ERROR("Create socket error!", port_);
-        return false;
+        return -1;
     }
     //设置套接字的选项
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
+    ret = setsockopt(listenFd, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
     if(ret < 0){
-        close(listenFd_);
+        close(listenFd);
         LOG_ERROR("Init linger error!", port_);
-        return false;
+        return -1;
     }
     
 
     int optval = 1;
     //SO_REUSEADDR:允许多个套接字绑定到相同的地址和端口(即使仍处于 TIME_WAIT 状态),服务器重启时可直接复用端口
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, (const void*)&optval, sizeof(int));
+    ret = setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, (const void*)&optval, sizeof(int));
     if(ret < 0){
         LOG_ERROR("set socket setsockopt error!");
-        close(listenFd_);
-        return false;
+        close(listenFd);
+        return -1;
+    }
+
+    //SO_REUSEPORT:多个套接字绑定同一端口，内核把新连接分散到各个套接字的accept队列
+    if(reusePort){
+        ret = setsockopt(listenFd, SOL_SOCKET, SO_REUSEPORT, (const void*)&optval, sizeof(int));
+        if(ret < 0){
+            LOG_ERROR("set SO_REUSEPORT error: %s", strerror(errno));
+            close(listenFd);
+            return -1;
+        }
     }
 
     //绑定套接字到指定的地址和端口
-    ret = bind(listenFd_, (struct sockaddr*) &addr, sizeof(addr));
+    ret = bind(listenFd, (struct sockaddr*) &addr, sizeof(addr));
     if(ret < 0){
         LOG_ERROR("Bind Port:%d error: %s", port_, strerror(errno));
         printf("Bind Port:%d error: %s\n", port_, strerror(errno));
         // fflush(stdout);
-        close(listenFd_);
-        return false;
+        close(listenFd);
+        return -1;
     }
-    //监听套接字，监听队列最大为6
-    ret = listen(listenFd_, 6);
+    //监听套接字，backlog_为全连接队列长度(实际还受net.core.somaxconn限制)
+    ret = listen(listenFd, backlog_);
     if(ret < 0){
         LOG_ERROR("Listen Port:%d error!",port_);
-        close(listenFd_);
-        return false;
+        close(listenFd);
+        return -1;
     }
-    //添加到epoll监听器
-    ret = epoller_->AddFd(listenFd_, listenEvent_ | EPOLLIN);
-    if(ret == 0){
-        LOG_ERROR("Add listen error!");
-        close(listenFd_);
-        return false;
+    SetFdNonblock(listenFd);
+    return listenFd;
+}
+
+//给reuseport组挂一个经典BPF程序：返回值 = 当前CPU编号 % 组内套接字数，即选中的套接字下标
+bool WebServer::AttachCpuSteering_(int fd, size_t groupSize){
+    struct sock_filter code[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU) },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)groupSize },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    struct sock_fprog prog = { sizeof(code) / sizeof(code[0]), code };
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0;
+}
+
+void WebServer::SetCpuAffinity(const std::vector<int>& cpus){
+    //第i个从reactor(线程池模式下为第i个工作线程)绑定到cpus[i % cpus.size()]
+    if(cpus.empty())return;
+    if(threadpool_){
+        threadpool_->SetCpuAffinity(cpus);
+        if(!threadpool_->IsPinned())LOG_WARN("ThreadPool bind cpu error!");
     }
-    SetFdNonblock(listenFd_);
-    LOG_INFO("Server port:%d", port_);
-    return true;
+    for(size_t i = 0; i < reactors_.size(); i++){
+        reactors_[i]->SetCpu(cpus[i % cpus.size()]);
+    }
+}
+
+void WebServer::SetCacheControl(const std::string& prefix, const std::string& value){
+    HttpResponse::AddCacheControl(prefix, value);
+    LOG_INFO("Cache-Control %s: %s", prefix.c_str(), value.c_str());
 }
 
 int WebServer::SetFdNonblock(int fd){
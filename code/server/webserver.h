@@ -1,66 +1,138 @@
 #ifndef WEBSERVER_H
 #define WEBSERVER_H
 
-#include <unordered_map>
 #include <fcntl.h>       // fcntl()
 #include <unistd.h>      // close()
 #include <assert.h>
 #include <errno.h>
+#include <signal.h>      // signal()
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <linux/filter.h>   // sock_filter, SKF_AD_CPU
+#include <functional>
+#include <sys/eventfd.h>
 
 #include "epoller.h"
-#include "../timer/heaptimer.h"
+#include "subreactor.h"
+#include "conntable.h"
+#include "../timer/timingwheel.h"
 #include "../log/log.h"
 #include "../pool/sqlconnpool.h"
 #include "../pool/threadpool.h"
+#include "../pool/dbexecutor.h"
 #include "../http/httpconn.h"
 
+//服务器配置：字段按名字设置，没设置的用默认值，新增选项只需在这里加字段
+struct ServerConfig{
+    int port = 1316;
+    int trigMode = 3;               //0:LT+LT 1:LT+ET(连接) 2:ET(监听)+LT 3:ET+ET
+    int timeoutMs = 60000;          //空闲超时，<=0时不启用连接超时
+    bool optLinger = false;
+
+    int sqlPort = 3306;
+    const char* sqlUser = "root";
+    const char* sqlPwd = "root";
+    const char* dbName = "webserver";
+    int connPoolNum = 12;           //连接池初始(最小)连接数
+    int sqlConnMax = 0;             //连接池上限，不大于connPoolNum时为定长
+    int sqlWaitMs = 3000;           //取连接的最长等待
+    int threadNum = 6;
+
+    bool openLog = true;
+    int logLevel = 1;
+    int logQueSize = 1024;          //为0时同步写日志
+    int logFormat = 0;              //Log::LOG_FORMAT
+
+    int reactorNum = 0;             //从reactor数，为0时使用 单Epoller + 线程池 模式
+    int dispatchMode = 0;           //见WebServer::dispatchMode_
+    int backlog = 1024;
+    bool connAffinity = false;      //线程池模式下同一个连接的任务固定交给同一个工作线程
+
+    int sendMode = 0;               //HttpResponse::SEND_MODE
+    int fileCacheNum = 0;
+    int respCacheSize = 0;
+    int maxBodySize = 1024 * 1024;
+    int bodySpillSize = 0;
+    bool autoIndex = false;
+    bool hashETag = false;
+    bool gzipStatic = false;
+    int gzipCacheSize = 0;
+
+    int headerTimeoutMs = 0;        //各阶段的超时，<=0时沿用timeoutMs
+    int bodyTimeoutMs = 0;
+    int writeTimeoutMs = 0;
+    int timerSlackMs = 10;          //时间轮的tick
+
+    int authCacheNum = 0;
+    int authCacheTtlMs = 60000;
+    int regBatchSize = 0;           //为0时注册不合批
+    int regBatchWaitUs = 1000;
+};
+
 class WebServer{
 public:
-    WebServer(int port,int trigMode, int timeoutMs, bool OptLinger,
-    int sqlPort, const char* sqlUser, const char* sqlPwd,
-    const char* dbName, int connPoolNumm ,int threadNum,
-    bool openLog, int logLevel, int logQueSize);
+    explicit WebServer(const ServerConfig& config);
 
     ~WebServer();
     void Start();
+    void SetCpuAffinity(const std::vector<int>& cpus);   //在Start之前调用，从reactor或工作线程绑核
+    void SetCacheControl(const std::string& prefix, const std::string& value);  //在Start之前调用
 
 private:
     bool InitSocket_();
+    int CreateListenFd_(bool reusePort);
+    static bool AttachCpuSteering_(int fd, size_t groupSize);
     void InitEventMode_(int trigMode);
     void AddClient_(int fd, sockaddr_in addr);
+    void AllocConn_(int fd, sockaddr_in addr);     //在负责fd的工作线程上分配HttpConn，完成后再AddClient_
 
     void DealListen_();
+    SubReactor* NextReactor_();
     void DealWrite_(HttpConn* client);
     void DealRead_(HttpConn* client);
 
+    void RunInLoop_(std::function<void()> task);   //线程池模式下把任务投递到主线程执行
+    void DoPendingTasks_();
+
     void SendError_(int fd, const char* info);
-    void ExtentTime_(HttpConn* client);
+    void UpdateTimer_(HttpConn* client);
     void CloseConn_(HttpConn* client);
+    static void OnTimeout_(void* arg, TimerNode* node);
 
     void OnRead_(HttpConn* client);
     void OnWrite_(HttpConn* client);
     void OnProcess_(HttpConn* client);
+    void Verify_(HttpConn* client);
+    void OnVerified_(HttpConn* client, bool ok);
 
     static const int MAX_FD = 65536;
     static int SetFdNonblock(int fd);
 
     int port_;
     bool openLinger_;
-    int timeoutMs_;
+    int timeoutMs_;         //空闲超时，<=0时不启用连接超时
     bool isClose_;
     int listenFd_;
+    int backlog_;
     char* srcDir_;
 
+    int dispatchMode_;      //0:轮询分发 1:分发给连接数最少的从reactor 2:SO_REUSEPORT每个从reactor自己accept 3:在2的基础上按CPU编号引流
+    size_t nextReactor_;
+    bool connAffinity_;     //线程池模式下同一个连接的任务固定交给同一个工作线程
+
     uint32_t listenEvent_;
     uint32_t connEvent_;
 
-    std::unique_ptr<HeapTimer>timer_;
+    std::unique_ptr<TimingWheel>timer_;
     std::unique_ptr<ThreadPool>threadpool_;
     std::unique_ptr<Epoller>epoller_;
-    std::unordered_map<int,HttpConn>users_;
+    ConnTable users_;
+    std::vector<std::unique_ptr<SubReactor>>reactors_;  //为空时使用 单Epoller + 线程池 模式
+
+    int wakeupFd_;          //线程池模式下唤醒主线程执行pendingTasks_
+    std::mutex mtx_;
+    std::vector<std::function<void()>> pendingTasks_;
 };
 
 #endif
\ No newline at end of file
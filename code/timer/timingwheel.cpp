@@ -0,0 +1,197 @@
+#include "timingwheel.h"
+
+using namespace std;
+
+TimingWheel::TimingWheel(ExpireCallBack cb, void* arg, int tickMs):
+    cb_(cb), arg_(arg), tickMs_(tickMs > 0 ? tickMs : 1), cur_(0), size_(0),
+    armed_(UINT64_MAX), dirty_(false), start_(Clock::now()){
+    assert(cb_);
+    for(int i = 0; i < SLOT_NUM; i++){
+        slots_[i].prev = slots_[i].next = &slots_[i];
+    }
+    memset(bits_, 0, sizeof(bits_));
+}
+
+TimingWheel::~TimingWheel(){
+    //节点归使用方所有，可能先于时间轮析构，这里不再访问它们
+}
+
+uint64_t TimingWheel::NowUs_() const{
+    return chrono::duration_cast<chrono::microseconds>(Clock::now() - start_).count();
+}
+
+void TimingWheel::Add(TimerNode* node, int timeoutMs){
+    assert(node);
+    if(node->Linked())Unlink_(node);
+    if(timeoutMs < 0)timeoutMs = 0;
+    //向上取整到tick，保证不会早于超时时间触发
+    node->expire = (NowMs_() + timeoutMs + tickMs_ - 1) / tickMs_;
+    if(node->expire < armed_)dirty_ = true;
+    Place_(node);
+}
+
+void TimingWheel::Del(TimerNode* node){
+    assert(node);
+    if(node->Linked())Unlink_(node);
+}
+
+//按距离cur_的远近决定放在哪一层，同一层内按到期时间取槽
+void TimingWheel::Place_(TimerNode* node){
+    uint64_t expire = node->expire < cur_ ? cur_ : node->expire;
+    uint64_t delta = expire - cur_;
+    if(delta < WHEEL0_SIZE){
+        Link_(node, expire & WHEEL0_MASK);
+        return;
+    }
+    int level = 1;
+    int shift = WHEEL0_BITS;
+    while(level < LEVEL_NUM - 1 && delta >= (1ULL << (shift + WHEELN_BITS))){
+        level++;
+        shift += WHEELN_BITS;
+    }
+    if(delta >= (1ULL << (shift + WHEELN_BITS))){
+        //超出整个轮的范围，先放在最高层最远的槽，级联时再重新放置
+        expire = cur_ + (1ULL << (shift + WHEELN_BITS)) - 1;
+    }
+    Link_(node, WHEEL0_SIZE + (level - 1) * WHEELN_SIZE + ((expire >> shift) & WHEELN_MASK));
+}
+
+void TimingWheel::Link_(TimerNode* node, int slot){
+    TimerNode* head = &slots_[slot];
+    node->next = head;
+    node->prev = head->prev;
+    head->prev->next = node;
+    head->prev = node;
+    node->slot = slot;
+    bits_[slot >> 6] |= 1ULL << (slot & 63);
+    size_++;
+}
+
+void TimingWheel::Unlink_(TimerNode* node){
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = nullptr;
+    size_--;
+    //节点可能在TakeSlot_取出的临时链表里，按原来的槽判断是否变空
+    TimerNode* head = &slots_[node->slot];
+    if(head->next == head){
+        bits_[node->slot >> 6] &= ~(1ULL << (node->slot & 63));
+    }
+}
+
+//把整个槽的链表一次性转移到list，回调里对轮的修改不会影响正在遍历的节点
+void TimingWheel::TakeSlot_(int slot, TimerNode* list){
+    TimerNode* head = &slots_[slot];
+    if(head->next == head){
+        list->prev = list->next = list;
+        return;
+    }
+    list->next = head->next;
+    list->prev = head->prev;
+    list->next->prev = list;
+    list->prev->next = list;
+    head->prev = head->next = head;
+    bits_[slot >> 6] &= ~(1ULL << (slot & 63));
+}
+
+//cur_对齐到某一层的一个槽的起点时，把该槽的节点重新放到下面的层
+void TimingWheel::Cascade_(){
+    int shift = WHEEL0_BITS;
+    for(int level = 1; level < LEVEL_NUM; level++, shift += WHEELN_BITS){
+        if(cur_ & ((1ULL << shift) - 1))break;
+        TimerNode list;
+        TakeSlot_(WHEEL0_SIZE + (level - 1) * WHEELN_SIZE + ((cur_ >> shift) & WHEELN_MASK), &list);
+        while(list.next != &list){
+            TimerNode* node = list.next;
+            Unlink_(node);
+            Place_(node);
+        }
+    }
+}
+
+//第0层从from开始环形查找第一个非空槽，返回与from的距离，全空返回-1
+int TimingWheel::FindSlot0_(int from) const{
+    const int WORDS = WHEEL0_SIZE / 64;
+    for(int i = 0; i <= WORDS; i++){
+        int w = ((from >> 6) + i) % WORDS;
+        uint64_t bits = bits_[w];
+        if(i == 0){
+            bits &= ~0ULL << (from & 63);
+        }else if(i == WORDS){
+            bits &= ~(~0ULL << (from & 63));
+        }
+        if(bits){
+            int slot = w * 64 + __builtin_ctzll(bits);
+            return (slot - from) & WHEEL0_MASK;
+        }
+    }
+    return -1;
+}
+
+//下一个需要处理的tick：第0层最近的非空槽，或上层最近一个非空槽的级联时刻
+uint64_t TimingWheel::NextExpire_() const{
+    uint64_t next = UINT64_MAX;
+    int dist = FindSlot0_(cur_ & WHEEL0_MASK);
+    if(dist >= 0)next = cur_ + dist;
+    int shift = WHEEL0_BITS;
+    for(int level = 1; level < LEVEL_NUM; level++, shift += WHEELN_BITS){
+        uint64_t bits = bits_[(WHEEL0_SIZE + (level - 1) * WHEELN_SIZE) >> 6];
+        if(!bits)continue;
+        //本层的级联发生在对齐到1<<shift的时刻，base为cur_之后(含)的第一个
+        uint64_t base = (cur_ + (1ULL << shift) - 1) >> shift;
+        int from = base & WHEELN_MASK;
+        uint64_t rotated = from ? (bits >> from) | (bits << (64 - from)) : bits;
+        uint64_t tick = (base + __builtin_ctzll(rotated)) << shift;
+        if(tick < next)next = tick;
+    }
+    return next;
+}
+
+void TimingWheel::Tick(){
+    uint64_t now = NowMs_() / tickMs_;
+    while(size_ > 0){
+        //直接跳到下一个有事可做的tick，空槽不逐个走
+        uint64_t next = NextExpire_();
+        if(next > now)break;
+        cur_ = next;
+        Cascade_();
+        TimerNode list;
+        TakeSlot_(cur_ & WHEEL0_MASK, &list);
+        cur_++;
+        while(list.next != &list){
+            TimerNode* node = list.next;
+            Unlink_(node);
+            cb_(arg_, node);
+        }
+    }
+    if(cur_ <= now)cur_ = now + 1;
+    if(armed_ <= now){
+        //timerfd已经触发，需要按剩下的节点重新设置
+        armed_ = UINT64_MAX;
+        dirty_ = size_ > 0;
+    }
+}
+
+int TimingWheel::GetNextTick(){
+    Tick();
+    if(size_ == 0)return -1;
+    int64_t ms = (int64_t)(NextExpire_() * tickMs_) - (int64_t)NowMs_();
+    if(ms < 0)return 0;
+    return ms > INT_MAX ? INT_MAX : (int)ms;
+}
+
+bool TimingWheel::NeedRearm(int* timeoutMs){
+    assert(timeoutMs);
+    if(!dirty_)return false;
+    dirty_ = false;
+    if(size_ == 0)return false;
+    uint64_t next = NextExpire_();
+    //timerfd设置得比需要的早只会多一次空的Tick，不值得为此重新设置
+    if(next >= armed_)return false;
+    armed_ = next;
+    //向上取整到毫秒，timerfd触发时这个tick一定已经到了
+    int64_t us = (int64_t)(next * tickMs_ * 1000) - (int64_t)NowUs_();
+    int64_t ms = us <= 0 ? 0 : (us + 999) / 1000;
+    *timeoutMs = ms > INT_MAX ? INT_MAX : (int)ms;
+    return true;
+}
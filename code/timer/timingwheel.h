@@ -0,0 +1,83 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <chrono>
+
+//侵入式定时器节点，嵌在被管理的对象(HttpConn)里，加入、调整、删除都不分配内存
+struct TimerNode{
+    TimerNode* prev;
+    TimerNode* next;
+    uint64_t expire;    //到期的tick
+    int slot;           //所在槽的编号
+    int kind;           //使用方自定义的定时器类型，时间轮不关心
+    void* data;         //到期时原样交给回调，一般指向宿主对象
+
+    TimerNode():prev(nullptr), next(nullptr), expire(0), slot(0), kind(0), data(nullptr){}
+    TimerNode(const TimerNode&) = delete;
+    TimerNode& operator=(const TimerNode&) = delete;
+
+    bool Linked() const { return next != nullptr; }
+};
+
+//分层时间轮：第0层256个槽，每槽一个tick；上面3层各64个槽，每槽覆盖下一层转一整圈的时间。
+//加入/调整/删除都是O(1)的链表操作，上层的节点转到时才下放(级联)到下层，
+//每个节点一生最多级联3次，大多数连接在那之前就已经被调整或删除了
+class TimingWheel{
+public:
+    typedef void (*ExpireCallBack)(void* arg, TimerNode* node);
+
+    //所有节点共用一个到期回调，不需要每个节点保存一个std::function；
+    //tickMs为时间精度，同一个tick内到期的节点一起处理，调大可以合并唤醒
+    TimingWheel(ExpireCallBack cb, void* arg, int tickMs = 1);
+    virtual ~TimingWheel();
+
+    void Add(TimerNode* node, int timeoutMs);   //加入，已在轮中则重新设置超时
+    void Del(TimerNode* node);
+    void Tick();            //处理所有已到期的节点
+    int GetNextTick();      //批量处理到期节点后返回距下一次到期的毫秒数，没有定时器返回-1
+    //配合timerfd使用：最早的到期时间比timerfd已设置的更早(或timerfd已经触发过)时返回true
+    //和需要设置的毫秒数，否则不用动timerfd，省掉每轮循环的系统调用
+    bool NeedRearm(int* timeoutMs);
+    size_t Size() const { return size_; }
+
+protected:
+    virtual uint64_t NowUs_() const;    //构造以来的微秒数，测试里换成手动推进的时钟
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    uint64_t NowMs_() const { return NowUs_() / 1000; }
+    void Place_(TimerNode* node);
+    void Link_(TimerNode* node, int slot);
+    void Unlink_(TimerNode* node);
+    void TakeSlot_(int slot, TimerNode* list);
+    void Cascade_();
+    uint64_t NextExpire_() const;
+    int FindSlot0_(int from) const;
+
+    static const int WHEEL0_BITS = 8;
+    static const int WHEEL0_SIZE = 1 << WHEEL0_BITS;
+    static const int WHEEL0_MASK = WHEEL0_SIZE - 1;
+    static const int WHEELN_BITS = 6;
+    static const int WHEELN_SIZE = 1 << WHEELN_BITS;
+    static const int WHEELN_MASK = WHEELN_SIZE - 1;
+    static const int LEVEL_NUM = 4;
+    static const int SLOT_NUM = WHEEL0_SIZE + (LEVEL_NUM - 1) * WHEELN_SIZE;
+
+    ExpireCallBack cb_;
+    void* arg_;
+    int tickMs_;
+    uint64_t cur_;          //下一个要处理的tick，之前的都已经处理过
+    size_t size_;
+    uint64_t armed_;        //timerfd设置的到期tick，没有设置时为UINT64_MAX
+    bool dirty_;            //加入了比armed_更早的节点，需要重新设置timerfd
+    Clock::time_point start_;
+    TimerNode slots_[SLOT_NUM];         //每个槽一个双向循环链表的哨兵
+    uint64_t bits_[SLOT_NUM / 64];      //非空槽的位图，用来跳过空槽、计算下一次到期
+};
+
+#endif
@@ -1,6 +1,14 @@
 #include "../code/log/log.h"
 #include "../code/pool/threadpool.h"
+#include "../code/http/httprequest.h"
+#include "../code/http/httpconn.h"
+#include "../code/http/responsecache.h"
+#include "../code/timer/timingwheel.h"
+#include <vector>
+#include <random>
 #include <features.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 
 #if __GLIBC__ == 2 && __GLIBC_MINOR__ < 30
 #include <sys/syscall.h>
@@ -30,12 +38,461 @@ void TestLog(){
     }
 }
 
+//把s追加到buff后解析一次
+HttpRequest::PARSE_RESULT ParseAppend(HttpRequest& request, ChainBuffer& buff, const std::string& s){
+    buff.Append(s.data(), s.size());
+    return request.parse(buff);
+}
+
+void TestHttpRequest(){
+    const std::string post = "POST /upload HTTP/1.1\r\nHost: a\r\nContent-Length: 11\r\n\r\nhello world";
+    const std::string chunked = "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "4;name=val\r\nWiki\r\n5 ; x\r\npedia\r\n0\r\nX-Trailer: 1\r\nX-Other: 2\r\n\r\n";
+
+    //在每个字节处切开分两次到达
+    for(const std::string* req: {&post, &chunked}){
+        for(size_t i = 0; i < req->size(); i++){
+            HttpRequest request;
+            ChainBuffer buff;
+            assert(ParseAppend(request, buff, req->substr(0, i)) == HttpRequest::PARSE_AGAIN);
+            assert(ParseAppend(request, buff, req->substr(i)) == HttpRequest::PARSE_OK);
+            assert(request.method() == "POST" && request.path() == "/upload");
+            assert(request.Body() == (req == &post ? "hello world" : "Wikipedia"));
+            assert(buff.ReadableBytes() == 0);
+        }
+    }
+    //逐字节到达
+    {
+        HttpRequest request;
+        ChainBuffer buff;
+        HttpRequest::PARSE_RESULT ret = HttpRequest::PARSE_AGAIN;
+        for(size_t i = 0; i < chunked.size(); i++){
+            assert(ret == HttpRequest::PARSE_AGAIN);
+            ret = ParseAppend(request, buff, chunked.substr(i, 1));
+        }
+        assert(ret == HttpRequest::PARSE_OK && request.Body() == "Wikipedia");
+        assert(request.Header("x-trailer").len == 0);   //trailer只跳过
+    }
+    //一次读到多个请求
+    {
+        HttpRequest request;
+        ChainBuffer buff;
+        std::string get = "GET / HTTP/1.1\r\nConnection: keep-alive\r\n\r\n";
+        assert(ParseAppend(request, buff, get + post + chunked + "GET /login") == HttpRequest::PARSE_OK);
+        assert(request.path() == "/index.html" && request.IsKeepAlive());
+        assert(request.parse(buff) == HttpRequest::PARSE_OK && request.Body() == "hello world");
+        assert(request.parse(buff) == HttpRequest::PARSE_OK && request.Body() == "Wikipedia");
+        assert(request.parse(buff) == HttpRequest::PARSE_AGAIN);
+        assert(ParseAppend(request, buff, " HTTP/1.1\r\n\r\n") == HttpRequest::PARSE_OK);
+        assert(request.path() == "/login.html" && buff.ReadableBytes() == 0);
+    }
+    //请求行跨两个块：前一个请求的正文把第一个块填到只剩几个字节
+    {
+        HttpRequest request;
+        ChainBuffer buff;
+        std::string head = "POST /a HTTP/1.1\r\nContent-Length: ";
+        size_t bodyLen = ChainBuffer::CHUNK_SIZE - 5 - head.size() - 5 - 4;
+        std::string first = head + std::to_string(bodyLen) + "\r\n\r\n" + std::string(bodyLen, 'x');
+        assert(first.size() == ChainBuffer::CHUNK_SIZE - 5);
+        std::string second = "GET /picture HTTP/1.1\r\nHost: a\r\n\r\n";
+        assert(ParseAppend(request, buff, first + second) == HttpRequest::PARSE_OK);
+        assert(request.BodyLength() == bodyLen);
+        assert(buff.PeekBytes() == 5 && buff.ReadableBytes() == second.size());
+        assert(request.parse(buff) == HttpRequest::PARSE_OK);
+        assert(request.path() == "/picture.html" && request.Header("Host").EqualsIgnoreCase("a"));
+    }
+    //Content-Length重复时必须一致
+    {
+        HttpRequest request;
+        ChainBuffer buff;
+        assert(ParseAppend(request, buff, "POST / HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 3\r\n\r\nabc")
+               == HttpRequest::PARSE_OK);
+        HttpRequest conflict;
+        ChainBuffer buff2;
+        assert(ParseAppend(conflict, buff2, "POST / HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 4\r\n\r\nabcd")
+               == HttpRequest::PARSE_ERROR);
+        assert(conflict.ErrorCode() == 400);
+    }
+    //正文超过上限返回413，chunked在累计超过时返回
+    {
+        size_t maxBody = HttpRequest::maxBodySize;
+        HttpRequest::maxBodySize = 8;
+        HttpRequest request;
+        ChainBuffer buff;
+        assert(ParseAppend(request, buff, "POST / HTTP/1.1\r\nContent-Length: 9\r\n\r\n") == HttpRequest::PARSE_ERROR);
+        assert(request.ErrorCode() == 413);
+        HttpRequest chunkedReq;
+        ChainBuffer buff2;
+        assert(ParseAppend(chunkedReq, buff2, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+               "5\r\nabcde\r\n4\r\n") == HttpRequest::PARSE_ERROR);
+        assert(chunkedReq.ErrorCode() == 413);
+        HttpRequest fit;
+        ChainBuffer buff3;
+        assert(ParseAppend(fit, buff3, "POST / HTTP/1.1\r\nContent-Length: 8\r\n\r\n12345678") == HttpRequest::PARSE_OK);
+        HttpRequest::maxBodySize = maxBody;
+    }
+    //块的分帧不计入头部大小：大量小块只受正文上限约束；块大小行和trailer各有自己的上限
+    {
+        std::string many = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+        for(int i = 0; i < 20000; i++)many += "1;ext=abc\r\nx\r\n";
+        many += "0\r\n\r\n";
+        HttpRequest request;
+        ChainBuffer buff;
+        assert(ParseAppend(request, buff, many) == HttpRequest::PARSE_OK);
+        assert(request.BodyLength() == 20000 && buff.ReadableBytes() == 0);
+
+        HttpRequest longLine;
+        ChainBuffer buff2;
+        assert(ParseAppend(longLine, buff2, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n1;" +
+               std::string(2000, 'e')) == HttpRequest::PARSE_ERROR);
+
+        HttpRequest trailers;
+        ChainBuffer buff3;
+        std::string big = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n1\r\nx\r\n0\r\n";
+        for(int i = 0; i < 20; i++)big += "X-Trailer: " + std::string(4000, 't') + "\r\n";
+        assert(ParseAppend(trailers, buff3, big) == HttpRequest::PARSE_ERROR);
+    }
+    //100-continue只在头部收完、正文被接受后回复一次
+    {
+        HttpRequest request;
+        ChainBuffer buff;
+        assert(ParseAppend(request, buff, "POST / HTTP/1.1\r\nExpect: 100-continue\r\n") == HttpRequest::PARSE_AGAIN);
+        assert(!request.ExpectContinue());
+        assert(ParseAppend(request, buff, "Content-Length: 3\r\n\r\n") == HttpRequest::PARSE_AGAIN);
+        assert(request.ExpectContinue() && !request.ExpectContinue());
+        assert(ParseAppend(request, buff, "abc") == HttpRequest::PARSE_OK);
+
+        size_t maxBody = HttpRequest::maxBodySize;
+        HttpRequest::maxBodySize = 2;
+        HttpRequest tooLarge;
+        ChainBuffer buff2;
+        assert(ParseAppend(tooLarge, buff2, "POST / HTTP/1.1\r\nExpect: 100-continue\r\nContent-Length: 3\r\n\r\n")
+               == HttpRequest::PARSE_ERROR);
+        assert(!tooLarge.ExpectContinue());
+        HttpRequest::maxBodySize = maxBody;
+
+        HttpRequest noBody;
+        ChainBuffer buff3;
+        assert(ParseAppend(noBody, buff3, "GET / HTTP/1.1\r\nExpect: 100-continue\r\n") == HttpRequest::PARSE_AGAIN);
+        assert(ParseAppend(noBody, buff3, "\r\n") == HttpRequest::PARSE_OK);
+        assert(!noBody.ExpectContinue());
+
+        HttpRequest chunkedReq;
+        ChainBuffer buff4;
+        assert(ParseAppend(chunkedReq, buff4, "POST / HTTP/1.1\r\nExpect: 100-continue\r\n"
+               "Transfer-Encoding: chunked\r\n\r\n") == HttpRequest::PARSE_AGAIN);
+        assert(chunkedReq.ExpectContinue());
+    }
+    //路径解码，..段不能逃出资源目录
+    {
+        HttpRequest request;
+        ChainBuffer buff;
+        assert(ParseAppend(request, buff, "GET /a%20b%3Fc.html?x=/../ HTTP/1.1\r\n\r\n") == HttpRequest::PARSE_OK);
+        assert(request.path() == "/a b?c.html");
+        assert(ParseAppend(request, buff, "GET /login?next=1 HTTP/1.1\r\n\r\n") == HttpRequest::PARSE_OK);
+        assert(request.path() == "/login.html");
+        assert(ParseAppend(request, buff, "GET /a/..b/.c/ HTTP/1.1\r\n\r\n") == HttpRequest::PARSE_OK);
+        for(const char* path: {"/../", "/..", "/a/../../b", "/%2e%2E/x", "/..%2f", "a.html", "/a%00", "/a%2", "/%zz"}){
+            HttpRequest bad;
+            ChainBuffer badBuff;
+            assert(ParseAppend(bad, badBuff, std::string("GET ") + path + " HTTP/1.1\r\n\r\n") == HttpRequest::PARSE_ERROR);
+            assert(bad.ErrorCode() == 400);
+        }
+    }
+}
+
+//时钟由测试推进的时间轮
+class ManualWheel: public TimingWheel{
+public:
+    ManualWheel(ExpireCallBack cb, void* arg, int tickMs = 1): TimingWheel(cb, arg, tickMs), nowMs(0){}
+    uint64_t nowMs;
+protected:
+    uint64_t NowUs_() const override { return nowMs * 1000; }
+};
+
+struct WheelCase{
+    ManualWheel* wheel;
+    std::vector<TimerNode> nodes;
+    std::vector<uint64_t> expire;       //每个节点应该到期的毫秒
+    std::vector<uint64_t> fired;        //实际到期的毫秒，没到期为0
+    std::vector<int> order;
+    int delOnFire = -1;                 //nodes[0]到期时删除这个节点
+    int addOnFire = -1;                 //nodes[0]到期时以超时0加入这个节点，当前tick已处理，下一个tick触发
+    int repeat = 0;                     //nodes[1]到期时重新加入的次数
+    WheelCase(size_t n): nodes(n), expire(n, 0), fired(n, 0){}
+};
+
+void OnWheelExpire(void* arg, TimerNode* node){
+    WheelCase* c = static_cast<WheelCase*>(arg);
+    int id = node - c->nodes.data();
+    assert(!node->Linked() && c->fired[id] == 0);
+    c->fired[id] = c->wheel->nowMs;
+    c->order.push_back(id);
+    if(id == 0 && c->delOnFire >= 0){
+        c->wheel->Del(&c->nodes[c->delOnFire]);
+    }
+    if(id == 0 && c->addOnFire >= 0){
+        c->expire[c->addOnFire] = c->wheel->nowMs + 1;
+        c->wheel->Add(&c->nodes[c->addOnFire], 0);
+    }
+    if(id == 1 && c->repeat > 0){
+        c->repeat--;
+        c->fired[id] = 0;
+        c->expire[id] = c->wheel->nowMs + 10;
+        c->wheel->Add(node, 10);
+    }
+}
+
+//按GetNextTick一跳一跳推进时钟，每个节点都应该恰好在到期的那一毫秒触发
+void RunWheel(WheelCase& c){
+    ManualWheel& wheel = *c.wheel;
+    int ms;
+    while((ms = wheel.GetNextTick()) >= 0){
+        assert(ms > 0);
+        for(size_t i = 0; i < c.nodes.size(); i++){
+            //下一次唤醒不能晚于任何一个节点的到期时间
+            assert(!c.nodes[i].Linked() || wheel.nowMs + ms <= c.expire[i]);
+        }
+        wheel.nowMs += ms;
+    }
+    assert(wheel.Size() == 0);
+}
+
+void TestTimingWheel(){
+    //跨越各层边界和整个轮范围的超时，按到期时间先后触发；
+    //超时为0的节点在已处理过的tick之后加入，要到下一个tick才触发，这里不用
+    {
+        std::mt19937 rng(12345);
+        const int N = 2000;
+        WheelCase c(N);
+        ManualWheel wheel(OnWheelExpire, &c);
+        c.wheel = &wheel;
+        const int bounds[] = {1, 255, 256, 257, 16383, 16384, 16385, (1 << 20) - 1, 1 << 20, (1 << 26) - 1, 1 << 26, INT_MAX};
+        wheel.nowMs = 7;   //起点不对齐到槽
+        wheel.Tick();
+        for(int i = 0; i < N; i++){
+            int timeout;
+            if(i < (int)(sizeof(bounds) / sizeof(bounds[0])))timeout = bounds[i];
+            else if(i % 3 == 0)timeout = 1 + rng() % 300;
+            else if(i % 3 == 1)timeout = 1 + rng() % 20000;
+            else timeout = 1 + rng() % (1 << 28);
+            c.expire[i] = wheel.nowMs + timeout;
+            wheel.Add(&c.nodes[i], timeout);
+            if(i % 97 == 0){
+                //边加边走，cur_不在0上时放置；不越过最近的到期时间
+                int step = rng() % 50;
+                int next = wheel.GetNextTick();
+                wheel.nowMs += next >= 0 && next < step ? next : step;
+                wheel.Tick();
+            }
+        }
+        RunWheel(c);
+        assert((int)c.order.size() == N);
+        for(int i = 0; i < N; i++){
+            assert(c.fired[i] == c.expire[i]);
+        }
+        for(int i = 1; i < N; i++){
+            assert(c.fired[c.order[i - 1]] <= c.fired[c.order[i]]);
+        }
+    }
+    //回调里删除同一个tick到期的节点、重新加入自己、加入超时为0的节点
+    {
+        WheelCase c(5);
+        ManualWheel wheel(OnWheelExpire, &c);
+        c.wheel = &wheel;
+        c.delOnFire = 2;
+        c.addOnFire = 4;
+        c.repeat = 3;
+        for(int i = 0; i < 3; i++){
+            c.expire[i] = 300;
+            wheel.Add(&c.nodes[i], 300);
+        }
+        c.expire[3] = 1000;
+        wheel.Add(&c.nodes[3], 5000);
+        wheel.Add(&c.nodes[3], 1000);  //已在轮中，重新设置
+        RunWheel(c);
+        assert(c.fired[0] == 300 && c.fired[2] == 0 && c.fired[3] == 1000);
+        assert(c.fired[1] == 330 && c.repeat == 0);
+        assert(c.fired[4] == 301);
+        assert(c.order.size() == 7);
+    }
+    //timerfd只在最早的到期时间提前或已经触发时才重新设置
+    {
+        WheelCase c(3);
+        ManualWheel wheel(OnWheelExpire, &c);
+        c.wheel = &wheel;
+        int ms = -1;
+        assert(!wheel.NeedRearm(&ms));
+        wheel.Add(&c.nodes[0], 100);
+        assert(wheel.NeedRearm(&ms) && ms == 100);
+        assert(!wheel.NeedRearm(&ms));
+        wheel.Add(&c.nodes[1], 200);
+        assert(!wheel.NeedRearm(&ms));
+        wheel.Add(&c.nodes[2], 50);
+        assert(wheel.NeedRearm(&ms) && ms == 50);
+        wheel.nowMs = 50;
+        wheel.Tick();
+        assert(c.fired[2] == 50);
+        assert(wheel.NeedRearm(&ms) && ms == 50);
+        wheel.Del(&c.nodes[0]);
+        wheel.Del(&c.nodes[1]);
+        wheel.nowMs = 100;
+        wheel.Tick();
+        assert(!wheel.NeedRearm(&ms) && wheel.Size() == 0 && wheel.GetNextTick() == -1);
+    }
+}
+
+//编码成二进制记录再按格式串还原，应该和直接snprintf的结果一样；size为还原时输出区的大小
+template<typename... Args>
+void CheckLogFormat(size_t size, const char* fmt, Args... args){
+    char record[1024] = {0};
+    size_t len = LogFormat::Encode(record, sizeof(record), 0, 1, 0, args...);
+    LogRecordHeader header;
+    memcpy(&header, record, sizeof(header));
+    assert(header.size == len && header.argNum == sizeof...(Args));
+    char out[1024], expect[1024];
+    assert(size <= sizeof(out));
+    size_t n = LogFormat::FormatArgs(fmt, record + sizeof(header), len - sizeof(header), header.argNum, out, size);
+    snprintf(expect, size, fmt, args...);
+    if(strcmp(out, expect) != 0 || n != strlen(out)){
+        fprintf(stderr, "format \"%s\": got \"%s\", expect \"%s\"\n", fmt, out, expect);
+        assert(false);
+    }
+}
+
+void TestLogFormat(){
+    int i = -42;
+    unsigned u = 3000000000u;
+    size_t z = 12345;
+    long long ll = -1234567890123LL;
+    unsigned long long ull = 18446744073709551615ULL;
+    short sh = -7;
+    char ch = 'x';
+    const char* str = "hello";
+    void* ptr = &i;
+    CheckLogFormat(1024, "plain text");
+    CheckLogFormat(1024, "100%% done %d%%", i);
+    CheckLogFormat(1024, "%d %i %5d %-5d| %05d %+d", i, i, i, i, i, i);
+    CheckLogFormat(1024, "%u %x %X %o %#x", u, u, u, u, u);
+    CheckLogFormat(1024, "%zu %zd %lu", z, z, (unsigned long)z);
+    CheckLogFormat(1024, "%lld %llu %llx %hd", ll, ull, ull, sh);
+    CheckLogFormat(1024, "%c%c|%3c", ch, 'y', ch);
+    CheckLogFormat(1024, "%s|%10s|%-10s|%.3s|%8.2s", str, str, str, str, str);
+    CheckLogFormat(1024, "%*d|%-*d|%.*s|%*.*s", 6, i, 6, i, 2, str, 6, 3, str);
+    CheckLogFormat(1024, "%f %.2f %10.3f %e %g %G", 3.14159, 2.5, -1.0 / 3, 12345.678, 0.0001, 1e20);
+    CheckLogFormat(1024, "%p %p", ptr, (void*)nullptr);
+    CheckLogFormat(1024, "%s", (const char*)nullptr);
+    CheckLogFormat(1024, "[%s] fd %d errno %d %s", "GET", 7, 11, "Resource temporarily unavailable");
+    //输出区放不下时和snprintf一样截断
+    CheckLogFormat(8, "%s-%d", "abcdef", 12345);
+    CheckLogFormat(5, "%%%%%%%%");
+
+    //记录放不下时字符串被截断，后面的参数丢掉，对应的转换说明输出<?>
+    char record[sizeof(LogRecordHeader) + 3 + 4];
+    size_t len = LogFormat::Encode(record, sizeof(record), 0, 1, 0, "truncated", 5);
+    assert(len == sizeof(record));
+    LogRecordHeader header;
+    memcpy(&header, record, sizeof(header));
+    char out[64];
+    LogFormat::FormatArgs("%s %d", record + sizeof(header), len - sizeof(header), header.argNum, out, sizeof(out));
+    assert(strcmp(out, "trun <?>") == 0);
+}
+
 void ThreadLogTask(int i, int cnt){
     for(int j = 0; j < 10000; j++){
         LOG_BASE(i, "PID:[%04d]=========%05d ==========",gettid(), cnt++);
     }
 }
 
+//通过socketpair发一个请求给conn，返回完整的响应
+std::string Exchange(HttpConn& conn, int peer, const std::string& req){
+    int err = 0;
+    assert(::write(peer, req.data(), req.size()) == (ssize_t)req.size());
+    assert(conn.read(&err) > 0);
+    assert(conn.process());
+    while(conn.ToWriteBytes() > 0){
+        assert(conn.write(&err) > 0);
+    }
+    std::string resp;
+    char buf[4096];
+    ssize_t n;
+    while((n = recv(peer, buf, sizeof(buf), MSG_DONTWAIT)) > 0){
+        resp.append(buf, n);
+    }
+    return resp;
+}
+
+std::string HeaderOf(const std::string& resp, const std::string& name){
+    size_t pos = resp.find("\r\n" + name + ": ");
+    if(pos == std::string::npos || pos > resp.find("\r\n\r\n"))return "";
+    pos += name.size() + 4;
+    return resp.substr(pos, resp.find("\r\n", pos) - pos);
+}
+
+void TestCompressResponse(){
+    //可压缩和压不小的两个文件，小于响应缓存的单文件上限
+    const std::string dir = "./testcompress";
+    mkdir(dir.c_str(), 0755);
+    std::string page, noise;
+    for(int i = 0; i < 200; i++)page += "<p>compress me " + std::to_string(i % 7) + "</p>\n";
+    std::mt19937 rng(7);
+    for(int i = 0; i < 6000; i++)noise += (char)rng();
+    FILE* fp = fopen((dir + "/page.html").c_str(), "w");
+    fwrite(page.data(), 1, page.size(), fp);
+    fclose(fp);
+    fp = fopen((dir + "/noise.html").c_str(), "w");
+    fwrite(noise.data(), 1, noise.size(), fp);
+    fclose(fp);
+
+    FileCache::Instance()->Init(dir, 16, true);
+    CompressCache::Instance()->Init(1024 * 1024);
+    ResponseCache::Instance()->Init(256 * 1024);
+    HttpConn::srcDir = dir.c_str();
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    sockaddr_in addr = {0};
+    HttpConn conn;
+    conn.init(fds[0], addr);
+
+    //第一次还在后台压缩，按原样发送；压缩完成后的请求要拿到gzip，不能被缓存住的原样响应挡住
+    for(const char* file: {"/page.html", "/noise.html"}){
+        const std::string get = std::string("GET ") + file +
+            " HTTP/1.1\r\nHost: a\r\nConnection: keep-alive\r\nAccept-Encoding: gzip\r\n\r\n";
+        std::string resp = Exchange(conn, fds[1], get);
+        assert(resp.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+        assert(HeaderOf(resp, "Content-Encoding").empty());
+        assert(HeaderOf(resp, "ETag").find("-gzip") == std::string::npos);
+        const std::string identityTag = HeaderOf(resp, "ETag");
+        bool isPage = strcmp(file, "/page.html") == 0;
+        for(int i = 0; i < 500 && CompressCache::Instance()->Hits() == 0; i++){
+            usleep(2000);
+            resp = Exchange(conn, fds[1], get);
+        }
+        for(int i = 0; i < 3; i++){
+            resp = Exchange(conn, fds[1], get);
+            assert(resp.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+            assert(HeaderOf(resp, "Content-Encoding") == (isPage ? "gzip" : ""));
+        }
+        //ETag和实际发送的编码一致：条件请求带上次拿到的标签得到304
+        const std::string tag = HeaderOf(resp, "ETag");
+        assert((tag.find("-gzip") != std::string::npos) == isPage);
+        assert(isPage || tag == identityTag);
+        resp = Exchange(conn, fds[1], std::string("GET ") + file +
+            " HTTP/1.1\r\nHost: a\r\nConnection: keep-alive\r\nAccept-Encoding: gzip\r\nIf-None-Match: " +
+            tag + "\r\n\r\n");
+        assert(resp.compare(0, 12, "HTTP/1.1 304") == 0);
+        CompressCache::Instance()->Init(1024 * 1024);   //清空计数给下一个文件用
+    }
+    conn.Close();
+    close(fds[1]);
+    ResponseCache::Instance()->Close();
+    CompressCache::Instance()->Close();
+    FileCache::Instance()->Close();
+    unlink((dir + "/page.html").c_str());
+    unlink((dir + "/noise.html").c_str());
+    rmdir(dir.c_str());
+}
+
 void TestThreadPool(){
     Log::Instance()->init(0, "./testThreadpool", ".log", 5000);
     ThreadPool threadpool(6);
@@ -47,6 +504,10 @@ void TestThreadPool(){
 
 int main(){
     TestLog();
+    TestHttpRequest();
+    TestTimingWheel();
+    TestLogFormat();
+    TestCompressResponse();
     TestThreadPool();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "../code/log/logformat.h"
+
+using namespace std;
+
+//把Log::BINARY格式的日志文件还原成文本，输出到标准输出: logdecode 2025_03_19.log ...
+static bool ReadFile(const char* path, vector<char>* data){
+    FILE* fp = fopen(path, "rb");
+    if(!fp)return false;
+    char buf[64 * 1024];
+    size_t n;
+    while((n = fread(buf, 1, sizeof(buf), fp)) > 0){
+        data->insert(data->end(), buf, buf + n);
+    }
+    fclose(fp);
+    return true;
+}
+
+//取出特殊记录里的参数：CLOCK_ID为两个整数，FORMAT_DEF_ID为编号和格式串
+static bool ReadInt(const char*& p, const char* end, int64_t* value){
+    if(end - p < 9 || (*p != LogFormat::ARG_INT && *p != LogFormat::ARG_UINT))return false;
+    memcpy(value, p + 1, sizeof(*value));
+    p += 9;
+    return true;
+}
+
+static bool ReadStr(const char*& p, const char* end, string* value){
+    uint16_t n;
+    if(end - p < 3 || *p != LogFormat::ARG_STR)return false;
+    memcpy(&n, p + 1, sizeof(n));
+    if(end - p - 3 < n)return false;
+    value->assign(p + 3, n);
+    p += 3 + n;
+    return true;
+}
+
+static int Decode(const char* path){
+    vector<char> data;
+    if(!ReadFile(path, &data)){
+        fprintf(stderr, "logdecode: cannot open %s\n", path);
+        return 1;
+    }
+    unordered_map<int, string> formats;
+    int64_t realBase = 0, monoBase = 0;
+    LogFormat::StampCache stamp;
+    vector<char> line(64 * 1024);
+    size_t pos = 0;
+    while(data.size() - pos >= sizeof(LogRecordHeader)){
+        LogRecordHeader header;
+        memcpy(&header, data.data() + pos, sizeof(header));
+        if(header.size < sizeof(header) || header.size > data.size() - pos){
+            fprintf(stderr, "logdecode: %s: broken record at offset %zu\n", path, pos);
+            return 1;
+        }
+        const char* record = data.data() + pos;
+        const char* p = record + sizeof(header);
+        const char* end = record + header.size;
+        if(header.fmtId == LogFormat::CLOCK_ID){
+            ReadInt(p, end, &realBase) && ReadInt(p, end, &monoBase);
+        }else if(header.fmtId == LogFormat::FORMAT_DEF_ID){
+            int64_t id;
+            string fmt;
+            if(ReadInt(p, end, &id) && ReadStr(p, end, &fmt))formats[(int)id] = fmt;
+        }else{
+            auto it = formats.find(header.fmtId);
+            size_t n = LogFormat::FormatLine(header, it != formats.end() ? it->second.c_str() : "<unknown format>",
+                                             record, realBase, monoBase, stamp, line.data(), line.size());
+            fwrite(line.data(), 1, n, stdout);
+        }
+        pos += header.size;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]){
+    if(argc < 2){
+        fprintf(stderr, "usage: %s file...\n", argv[0]);
+        return 2;
+    }
+    int ret = 0;
+    for(int i = 1; i < argc; i++){
+        ret |= Decode(argv[i]);
+    }
+    return ret;
+}